@@ -0,0 +1,47 @@
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<std::uint64_t> allocation_count{0};
+    std::atomic<std::uint64_t> allocated_bytes{0};
+
+    void* counted_alloc(std::size_t size, std::size_t alignment) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        if (size == 0) size = 1;
+        void* p;
+        if (alignment > alignof(std::max_align_t)) {
+            // aligned_alloc wants the size to be a multiple of the alignment.
+            p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+        } else {
+            p = std::malloc(size);
+        }
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+}
+
+AllocCounter::Snapshot AllocCounter::now() {
+    return {allocation_count.load(std::memory_order_relaxed), allocated_bytes.load(std::memory_order_relaxed)};
+}
+
+// The nothrow forms of new forward to these in libstdc++ and libc++, so
+// replacing the throwing ones covers them. Every delete goes to free(),
+// matching the allocation above.
+void* operator new(std::size_t size) { return counted_alloc(size, 0); }
+void* operator new[](std::size_t size) { return counted_alloc(size, 0); }
+void* operator new(std::size_t size, std::align_val_t al) { return counted_alloc(size, static_cast<std::size_t>(al)); }
+void* operator new[](std::size_t size, std::align_val_t al) { return counted_alloc(size, static_cast<std::size_t>(al)); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+// Totals kept by the replacement global operator new in alloc_counter.cpp.
+// Linking that file into a binary counts every heap allocation it makes,
+// from any thread.
+namespace AllocCounter {
+    struct Snapshot {
+        std::uint64_t allocations = 0;
+        std::uint64_t bytes = 0;
+    };
+
+    Snapshot now();
+}
+
+// Runs the benchmark loop over body() and reports the allocations it made
+// as allocs/iter and bytes/iter counters. Only the loop itself is counted,
+// not the setup before it or the counters set after it:
+//   counted_loop(state, [&] { ... });
+template <typename Body>
+void counted_loop(benchmark::State& state, Body body) {
+    AllocCounter::Snapshot start = AllocCounter::now();
+    for (auto _ : state) {
+        body();
+    }
+    AllocCounter::Snapshot end = AllocCounter::now();
+    state.counters["allocs/iter"] =
+            benchmark::Counter(static_cast<double>(end.allocations - start.allocations), benchmark::Counter::kAvgIterations);
+    state.counters["bytes/iter"] =
+            benchmark::Counter(static_cast<double>(end.bytes - start.bytes), benchmark::Counter::kAvgIterations);
+}
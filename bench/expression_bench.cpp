@@ -0,0 +1,101 @@
+// Expression evaluation: the tree walk, the memoized walk, the compiled
+// program and the columnar batch path, all over the Horner formula used by
+// task 8's own benchmarks.
+#define EXPRESSION_NO_MAIN
+#include "../task 8/main.cpp"
+
+#include <benchmark/benchmark.h>
+
+#include "alloc_counter.h"
+
+namespace {
+    struct Formula {
+        std::vector<std::string> names;
+        std::shared_ptr<Expression> expression = benchmarkFormula(names);
+        std::map<std::string, int> context;
+
+        Formula() {
+            for (size_t i = 0; i < names.size(); ++i) context[names[i]] = static_cast<int>(i) * 7 - 20;
+        }
+    };
+
+    void BM_ExpressionEvaluate(benchmark::State& state) {
+        Formula formula;
+        counted_loop(state, [&] {
+            benchmark::DoNotOptimize(formula.expression->evaluate(formula.context));
+        });
+    }
+    BENCHMARK(BM_ExpressionEvaluate);
+
+    void BM_ExpressionEvaluateCached(benchmark::State& state) {
+        Formula formula;
+        EvaluationMemo memo(*formula.expression);
+        counted_loop(state, [&] {
+            memo.clear();
+            benchmark::DoNotOptimize(formula.expression->evaluateCached(formula.context, memo));
+        });
+    }
+    BENCHMARK(BM_ExpressionEvaluateCached);
+
+    // The shared-subexpression formula from runDagBenchmark(): about 2*depth
+    // unique nodes, 2^depth leaves when walked as a tree.
+    std::shared_ptr<Expression> dagFormula(int depth) {
+        auto& factory = ExpressionFactory::instance();
+        auto x = factory.createVariable("x");
+        std::shared_ptr<Expression> formula = x;
+        for (int i = 0; i < depth; ++i) formula = add(add(formula, x), add(formula, x));
+        return formula;
+    }
+
+    void BM_ExpressionEvaluateDag(benchmark::State& state) {
+        std::shared_ptr<Expression> formula = dagFormula(static_cast<int>(state.range(0)));
+        std::map<std::string, int> context{{"x", 1}};
+        counted_loop(state, [&] {
+            benchmark::DoNotOptimize(formula->evaluate(context));
+        });
+    }
+    BENCHMARK(BM_ExpressionEvaluateDag)->Arg(12);
+
+    void BM_ExpressionEvaluateCachedDag(benchmark::State& state) {
+        std::shared_ptr<Expression> formula = dagFormula(static_cast<int>(state.range(0)));
+        std::map<std::string, int> context{{"x", 1}};
+        EvaluationMemo memo(*formula);
+        counted_loop(state, [&] {
+            memo.clear();
+            benchmark::DoNotOptimize(formula->evaluateCached(context, memo));
+        });
+    }
+    BENCHMARK(BM_ExpressionEvaluateCachedDag)->Arg(12);
+
+    void BM_CompiledEvaluate(benchmark::State& state) {
+        Formula formula;
+        CompiledExpression compiled = compile(*formula.expression, formula.names);
+        std::vector<int> values = compiled.bind(formula.context);
+        counted_loop(state, [&] {
+            benchmark::DoNotOptimize(compiled.evaluate(values));
+        });
+    }
+    BENCHMARK(BM_CompiledEvaluate);
+
+    void BM_CompiledEvaluateBatch(benchmark::State& state) {
+        Formula formula;
+        CompiledExpression compiled = compile(*formula.expression, formula.names);
+        size_t rows = static_cast<size_t>(state.range(0));
+        std::vector<std::vector<int>> data(formula.names.size(), std::vector<int>(rows));
+        ColumnContext columns;
+        for (size_t v = 0; v < data.size(); ++v) {
+            for (size_t r = 0; r < rows; ++r) data[v][r] = static_cast<int>((r * 31 + v * 17) % 2001) - 1000;
+            columns.add(formula.names[v], data[v]);
+        }
+        std::vector<int> out(rows);
+        std::vector<std::uint8_t> overflow(rows);
+
+        counted_loop(state, [&] {
+            benchmark::DoNotOptimize(compiled.evaluateBatch(columns, out, overflow));
+        });
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_CompiledEvaluateBatch)->RangeMultiplier(16)->Range(256, 1 << 20);
+}
+
+BENCHMARK_MAIN();
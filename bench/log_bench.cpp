@@ -0,0 +1,65 @@
+// Log::message on its synchronous, filtered, sink and async paths.
+#define LOG_NO_MAIN
+#include "../task 5/main.cpp"
+
+#include <benchmark/benchmark.h>
+
+#include "alloc_counter.h"
+
+namespace {
+    constexpr std::string_view kMessage = "Checkpoint 42 reached by runner 1337";
+
+    std::ostream& null_stream() {
+        static std::ostream stream(nullptr);
+        return stream;
+    }
+
+    // Into the history ring only.
+    void BM_LogMessage(benchmark::State& state) {
+        Log* log = Log::Instance();
+        counted_loop(state, [&] {
+            log->message(LOG_NORMAL, kMessage);
+        });
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_LogMessage);
+
+    // Below the runtime level: the early-out every disabled call pays.
+    void BM_LogMessageFiltered(benchmark::State& state) {
+        Log* log = Log::Instance();
+        log->set_level(LOG_WARNING);
+        counted_loop(state, [&] {
+            log->message(LOG_NORMAL, kMessage);
+        });
+        log->set_level(LOG_NORMAL);
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_LogMessageFiltered);
+
+    // History plus a MemorySink on the level.
+    void BM_LogMessageMemorySink(benchmark::State& state) {
+        Log* log = Log::Instance();
+        log->set_sink(LOG_NORMAL, std::make_shared<MemorySink>(1024));
+        counted_loop(state, [&] {
+            log->message(LOG_NORMAL, kMessage);
+        });
+        log->set_sink(LOG_NORMAL, nullptr);
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_LogMessageMemorySink);
+
+    // Producer cost in async mode; the writer thread formats to a null stream.
+    void BM_LogMessageAsync(benchmark::State& state) {
+        Log* log = Log::Instance();
+        log->start_async(null_stream());
+        counted_loop(state, [&] {
+            log->message(LOG_NORMAL, kMessage);
+        });
+        log->flush();
+        log->stop_async();
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_LogMessageAsync);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,80 @@
+// Set add/contains/intersection across sizes. The second argument picks
+// the key pattern: 0 for random keys over four times the size, 1 for a
+// dense run of consecutive ids (which ends up in the bitmap representation).
+#define SET_NO_MAIN
+#include "../task 7/main.cpp"
+
+#include <benchmark/benchmark.h>
+
+#include "alloc_counter.h"
+
+namespace {
+    std::vector<int> make_keys(size_t count, bool dense, unsigned seed) {
+        std::vector<int> keys(count);
+        if (dense) {
+            for (size_t i = 0; i < count; ++i) keys[i] = static_cast<int>(i + seed * count / 2);
+        } else {
+            std::mt19937 rng(seed);
+            std::uniform_int_distribution<int> dist(0, static_cast<int>(count * 4));
+            for (auto& key : keys) key = dist(rng);
+        }
+        return keys;
+    }
+
+    void set_labels(benchmark::State& state) {
+        state.SetLabel(state.range(1) ? "dense" : "sparse");
+    }
+
+    void BM_SetAdd(benchmark::State& state) {
+        auto keys = make_keys(static_cast<size_t>(state.range(0)), state.range(1) != 0, 1);
+        counted_loop(state, [&] {
+            Set s;
+            for (int key : keys) s.add(key);
+            benchmark::DoNotOptimize(s.size());
+        });
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+        set_labels(state);
+    }
+
+    void BM_SetContains(benchmark::State& state) {
+        auto keys = make_keys(static_cast<size_t>(state.range(0)), state.range(1) != 0, 1);
+        Set s = Set::from_range(keys);
+        // Alternate between present keys and keys drawn from a second,
+        // mostly disjoint pattern.
+        auto others = make_keys(keys.size(), state.range(1) != 0, 2);
+        std::vector<int> probes(1024);
+        for (size_t i = 0; i < probes.size(); ++i) {
+            probes[i] = (i % 2 ? others : keys)[i % keys.size()];
+        }
+
+        size_t i = 0;
+        counted_loop(state, [&] {
+            benchmark::DoNotOptimize(s.contains(probes[i++ & 1023]));
+        });
+        state.SetItemsProcessed(state.iterations());
+        set_labels(state);
+    }
+
+    // Two sets of the same size whose key patterns overlap by about half.
+    void BM_SetIntersection(benchmark::State& state) {
+        size_t count = static_cast<size_t>(state.range(0));
+        bool dense = state.range(1) != 0;
+        Set a = Set::from_range(make_keys(count, dense, 1));
+        Set b = Set::from_range(make_keys(count, dense, 2));
+
+        counted_loop(state, [&] {
+            benchmark::DoNotOptimize(a.intersection_with(b).size());
+        });
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+        set_labels(state);
+    }
+
+    void set_sizes(benchmark::internal::Benchmark* b) {
+        b->ArgsProduct({{16, 128, 1024, 8192, 65536, 1 << 19}, {0, 1}});
+    }
+    BENCHMARK(BM_SetAdd)->Apply(set_sizes);
+    BENCHMARK(BM_SetContains)->Apply(set_sizes);
+    BENCHMARK(BM_SetIntersection)->Apply(set_sizes);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,81 @@
+// TypeMap access through both storage policies.
+#define TYPEMAP_NO_MAIN
+#include "../task 3/main.cpp"
+
+#include <benchmark/benchmark.h>
+
+#include "alloc_counter.h"
+
+namespace {
+    using OptionalMap = TypeMap<int, DataA, double, DataB>;
+    using PackedMap = BasicTypeMap<PackedStorage<TypeListUtilities::TypeList<DataB>>, int, DataA, double, DataB>;
+
+    template <typename Map>
+    Map filled_map() {
+        Map map;
+        map.AddValue(42);
+        map.AddValue(DataA{"value"});
+        map.AddValue(3.14);
+        map.AddValue(DataB{10});
+        return map;
+    }
+
+    template <typename Map>
+    void BM_TypeMapGet(benchmark::State& state) {
+        Map map = filled_map<Map>();
+        counted_loop(state, [&] {
+            benchmark::DoNotOptimize(map.template GetValue<int>());
+            benchmark::DoNotOptimize(map.template GetValue<double>());
+            benchmark::DoNotOptimize(map.template GetValue<DataB>().value);
+        });
+        state.SetItemsProcessed(state.iterations() * 3);
+    }
+    BENCHMARK_TEMPLATE(BM_TypeMapGet, OptionalMap);
+    BENCHMARK_TEMPLATE(BM_TypeMapGet, PackedMap);
+
+    template <typename Map>
+    void BM_TypeMapAddRemove(benchmark::State& state) {
+        Map map = filled_map<Map>();
+        counted_loop(state, [&] {
+            map.template RemoveValue<int>();
+            benchmark::DoNotOptimize(map.template Contains<int>());
+            map.AddValue(7);
+        });
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK_TEMPLATE(BM_TypeMapAddRemove, OptionalMap);
+    BENCHMARK_TEMPLATE(BM_TypeMapAddRemove, PackedMap);
+
+    // Visits every stored value; DataA is absent, so one bit test fails.
+    // DoNotOptimize(map) makes both layouts reload their presence state.
+    template <typename Map>
+    void BM_TypeMapForEachPresent(benchmark::State& state) {
+        Map map = filled_map<Map>();
+        map.template RemoveValue<DataA>();
+        counted_loop(state, [&] {
+            benchmark::DoNotOptimize(map);
+            std::size_t sum = 0;
+            map.for_each_present([&](const auto& value) { sum += sizeof(value); });
+            benchmark::DoNotOptimize(sum);
+        });
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK_TEMPLATE(BM_TypeMapForEachPresent, OptionalMap);
+    BENCHMARK_TEMPLATE(BM_TypeMapForEachPresent, PackedMap);
+
+    // Runtime-tag access, cycling through every type.
+    template <typename Map>
+    void BM_TypeMapByIndex(benchmark::State& state) {
+        Map map = filled_map<Map>();
+        std::size_t tag = 0;
+        counted_loop(state, [&] {
+            benchmark::DoNotOptimize(map.get_by_index(tag));
+            tag = (tag + 1) % Map::size();
+        });
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK_TEMPLATE(BM_TypeMapByIndex, OptionalMap);
+    BENCHMARK_TEMPLATE(BM_TypeMapByIndex, PackedMap);
+}
+
+BENCHMARK_MAIN();
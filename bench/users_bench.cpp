@@ -0,0 +1,61 @@
+// UserManager create/delete/lookup.
+#define USERS_NO_MAIN
+#include "../task 1/main.cpp"
+
+#include <benchmark/benchmark.h>
+
+#include "alloc_counter.h"
+
+namespace {
+    // Output sink that drops everything, so lookups measure the manager
+    // rather than stream formatting.
+    std::ostream& null_stream() {
+        static std::ostream stream(nullptr);
+        return stream;
+    }
+
+    std::vector<std::string> user_names(int count) {
+        std::vector<std::string> names;
+        names.reserve(count);
+        for (int i = 0; i < count; ++i) names.push_back("user" + std::to_string(i));
+        return names;
+    }
+
+    // Creates range(0) users spread over 16 groups, then deletes them.
+    void BM_UserCreateDelete(benchmark::State& state) {
+        const int users = static_cast<int>(state.range(0));
+        auto names = user_names(users);
+        UserManager manager(null_stream());
+        manager.reserve(users, 16);
+        for (int group = 0; group < 16; ++group) manager.create_group(group);
+
+        counted_loop(state, [&] {
+            for (int id = 0; id < users; ++id) manager.create_user(id, names[id], id % 16);
+            for (int id = 0; id < users; ++id) manager.delete_user(id);
+        });
+        state.SetItemsProcessed(state.iterations() * users * 2);
+    }
+    BENCHMARK(BM_UserCreateDelete)->RangeMultiplier(8)->Range(64, 1 << 18);
+
+    // print_user() against a null stream: the id lookup plus the handle
+    // dereferences, half of the probes missing.
+    void BM_UserLookup(benchmark::State& state) {
+        const int users = static_cast<int>(state.range(0));
+        auto names = user_names(users);
+        UserManager manager(null_stream());
+        for (int id = 0; id < users; ++id) manager.create_user(id * 2, names[id]);
+
+        std::mt19937 rng(7);
+        std::vector<int> probes(1024);
+        for (auto& id : probes) id = static_cast<int>(rng() % (2 * static_cast<unsigned>(users)));
+
+        size_t i = 0;
+        counted_loop(state, [&] {
+            manager.print_user(probes[i++ & 1023]);
+        });
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_UserLookup)->RangeMultiplier(8)->Range(64, 1 << 18);
+}
+
+BENCHMARK_MAIN();
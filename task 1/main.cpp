@@ -1,46 +1,426 @@
 #include <iostream>
-#include <memory>
-#include <map>
 #include <vector>
 #include <algorithm>
 #include <sstream>
+#include <string_view>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <utility>
+#include <bit>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-class Group;
+// Users and groups live in ObjectPools and refer to each other through
+// handles, which are plain indices into the pools.
+using Handle = uint32_t;
+inline constexpr Handle kNoHandle = UINT32_MAX;
 
-class User : public std::enable_shared_from_this<User> {
+// Contiguous slab of T. Released slots go onto a free list and are handed
+// out again by acquire() without being destroyed, so objects that own
+// buffers keep their capacity and churn does not touch the allocator.
+template <typename T>
+class ObjectPool {
 public:
-    User(int id, std::string name) : id_(id), name_(std::move(name)) {}
+    Handle acquire() {
+        if (!free_.empty()) {
+            Handle handle = free_.back();
+            free_.pop_back();
+            return handle;
+        }
+        slots_.emplace_back();
+        return static_cast<Handle>(slots_.size() - 1);
+    }
 
-    int id() const { return id_; }
-    const std::string& name() const { return name_; }
-    std::shared_ptr<Group> group() const { return group_.lock(); }
+    void release(Handle handle) { free_.push_back(handle); }
 
-    void set_group(const std::shared_ptr<Group>& group);
-    void remove_group();
+    T& operator[](Handle handle) { return slots_[handle]; }
+    const T& operator[](Handle handle) const { return slots_[handle]; }
+
+    size_t live() const { return slots_.size() - free_.size(); }
+
+    void reserve(size_t count) {
+        slots_.reserve(count);
+        free_.reserve(count);
+    }
 
 private:
-    int id_;
-    std::string name_;
-    std::weak_ptr<Group> group_;
+    std::vector<T> slots_;
+    std::vector<Handle> free_;
 };
 
-class Group {
+// Reference-counted store for names that do not fit inline in CompactName.
+// Equal names share one entry; released entries are recycled.
+class NamePool {
+public:
+    uint32_t intern(std::string_view name) {
+        if (auto it = index_.find(name); it != index_.end()) {
+            ++entries_[it->second].refs;
+            return it->second;
+        }
+
+        uint32_t id;
+        if (!free_.empty()) {
+            id = free_.back();
+            free_.pop_back();
+        } else {
+            id = static_cast<uint32_t>(entries_.size());
+            entries_.emplace_back();
+        }
+        entries_[id].text.assign(name);
+        entries_[id].refs = 1;
+        index_.emplace(entries_[id].text, id);
+        return id;
+    }
+
+    void release(uint32_t id) {
+        if (--entries_[id].refs == 0) {
+            index_.erase(entries_[id].text);
+            free_.push_back(id);
+        }
+    }
+
+    std::string_view get(uint32_t id) const { return entries_[id].text; }
+
+private:
+    struct Entry {
+        std::string text;
+        uint32_t refs = 0;
+    };
+
+    std::deque<Entry> entries_;  // deque keeps the keys of index_ stable
+    std::vector<uint32_t> free_;
+    std::unordered_map<std::string_view, uint32_t> index_;
+};
+
+// Name stored inline when it is short, otherwise as an id into a NamePool.
+class CompactName {
 public:
-    explicit Group(int id) : id_(id) {}
+    static constexpr size_t kInlineCapacity = 23;
 
+    void assign(std::string_view name, NamePool& pool) {
+        release(pool);
+        if (name.size() <= kInlineCapacity) {
+            std::copy(name.begin(), name.end(), inline_);
+            length_ = static_cast<uint8_t>(name.size());
+        } else {
+            pooled_ = pool.intern(name);
+            length_ = kPooled;
+        }
+    }
+
+    void release(NamePool& pool) {
+        if (length_ == kPooled) pool.release(pooled_);
+        length_ = 0;
+    }
+
+    std::string_view view(const NamePool& pool) const {
+        if (length_ == kPooled) return pool.get(pooled_);
+        return {inline_, length_};
+    }
+
+private:
+    static constexpr uint8_t kPooled = 0xFF;
+
+    char inline_[kInlineCapacity];
+    uint8_t length_ = 0;
+    uint32_t pooled_ = 0;
+};
+
+class User {
+public:
     int id() const { return id_; }
-    std::vector<std::shared_ptr<User>> users() const;
+    Handle group() const { return group_; }
 
-    void add_user(const std::shared_ptr<User>& user);
-    void remove_user(const std::shared_ptr<User>& user);
+private:
+    friend class UserManager;
+
+    int id_ = 0;
+    CompactName name_;
+    Handle group_ = kNoHandle;
+    uint32_t group_slot_ = 0;  // position of this user in its group's users_
+};
+
+// Members are a dense array of user handles. Every User knows its own slot,
+// so removal is a swap with the last member and a pop; member order is
+// therefore not preserved across removals.
+class Group {
+public:
+    int id() const { return id_; }
+    const std::vector<Handle>& users() const { return users_; }
 
 private:
-    int id_;
-    std::vector<std::weak_ptr<User>> users_;
+    friend class UserManager;
+
+    int id_ = 0;
+    std::vector<Handle> users_;
 };
 
+// Open-addressing hash index keyed by integer id. Slots live in one flat
+// array with linear probing, so a lookup is usually a single cache line.
+// Erase uses backward shifting, which keeps probe chains short without
+// tombstones. Iteration order is unspecified; use sorted_keys() when the
+// caller needs ids in ascending order.
+template <typename Value>
+class FlatIdMap {
+public:
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    bool contains(int id) const { return find(id) != nullptr; }
+
+    Value* find(int id) {
+        return const_cast<Value*>(std::as_const(*this).find(id));
+    }
+
+    const Value* find(int id) const {
+        if (slots_.empty()) return nullptr;
+        for (size_t i = home(id);; i = (i + 1) & mask()) {
+            const Slot& slot = slots_[i];
+            if (!slot.occupied) return nullptr;
+            if (slot.key == id) return &slot.value;
+        }
+    }
+
+    // Inserts value under id unless it is already present. Returns the stored
+    // value and whether an insertion happened.
+    std::pair<Value*, bool> try_emplace(int id, Value value) {
+        if ((size_ + 1) * 4 > slots_.size() * 3) grow();
+        size_t i = home(id);
+        for (; slots_[i].occupied; i = (i + 1) & mask()) {
+            if (slots_[i].key == id) return {&slots_[i].value, false};
+        }
+        slots_[i] = Slot{std::move(value), id, true};
+        ++size_;
+        return {&slots_[i].value, true};
+    }
+
+    bool erase(int id) {
+        if (slots_.empty()) return false;
+        size_t i = home(id);
+        for (; slots_[i].key != id; i = (i + 1) & mask()) {
+            if (!slots_[i].occupied) return false;
+        }
+        if (!slots_[i].occupied) return false;
+
+        for (size_t j = (i + 1) & mask(); slots_[j].occupied; j = (j + 1) & mask()) {
+            size_t ideal = home(slots_[j].key);
+            if (((j - ideal) & mask()) >= ((j - i) & mask())) {
+                slots_[i] = std::move(slots_[j]);
+                i = j;
+            }
+        }
+        slots_[i] = Slot{};
+        --size_;
+        return true;
+    }
+
+    void reserve(size_t count) {
+        while (count * 4 > slots_.size() * 3) grow();
+    }
+
+    template <typename F>
+    void for_each(F&& f) const {
+        for (const auto& slot : slots_) {
+            if (slot.occupied) f(slot.key, slot.value);
+        }
+    }
+
+    std::vector<int> sorted_keys() const {
+        std::vector<int> keys;
+        keys.reserve(size_);
+        for_each([&keys](int id, const Value&) { keys.push_back(id); });
+        std::sort(keys.begin(), keys.end());
+        return keys;
+    }
+
+private:
+    struct Slot {
+        Value value{};
+        int key = 0;
+        bool occupied = false;
+    };
+
+    std::vector<Slot> slots_;
+    size_t size_ = 0;
+    unsigned shift_ = 64;
+
+    size_t mask() const { return slots_.size() - 1; }
+
+    size_t home(int id) const {
+        // Fibonacci hashing spreads sequential ids across the table.
+        return static_cast<size_t>(
+                (static_cast<uint64_t>(static_cast<uint32_t>(id)) * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    void grow() {
+        std::vector<Slot> old = std::move(slots_);
+        size_t capacity = old.empty() ? 16 : old.size() * 2;
+        slots_ = std::vector<Slot>(capacity);
+        shift_ = 64 - static_cast<unsigned>(std::countr_zero(capacity));
+        size_ = 0;
+        for (auto& slot : old) {
+            if (slot.occupied) try_emplace(slot.key, std::move(slot.value));
+        }
+    }
+};
+
+// Read-only view of a whole file. Mapped with mmap where available so a
+// snapshot is usable without copying it; read into memory elsewhere.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info {};
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            return;
+        }
+        if (info.st_size > 0) {
+            void* mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data_ = static_cast<const char*>(mapped);
+                size_ = static_cast<size_t>(info.st_size);
+                mapped_ = true;
+            }
+        }
+        ok_ = info.st_size == 0 || mapped_;
+        ::close(fd);
+#else
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) return;
+        char chunk[1 << 16];
+        size_t read;
+        while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            buffer_.insert(buffer_.end(), chunk, chunk + read);
+        }
+        std::fclose(file);
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        ok_ = true;
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapped_) ::munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool ok() const { return ok_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool ok_ = false;
+    bool mapped_ = false;
+    std::vector<char> buffer_;
+};
+
+// Pushes a written file through to stable storage. Where fsync is not
+// available only the C library buffer is flushed.
+bool sync_file(std::FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#if defined(__unix__) || defined(__APPLE__)
+    return ::fsync(::fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+// Makes a rename into path's directory durable.
+bool sync_parent_directory(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    return true;
+#endif
+}
+
+// Snapshot layout (native byte order), every section 4-byte aligned:
+//   SnapshotHeader
+//   int32  group_ids[group_count]
+//   int32  user_ids[user_count]
+//   int32  user_group_ids[user_count]      -1 for no group
+//   uint32 name_offsets[user_count + 1]    into the name pool
+//   char   names[names_size]
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t user_count;
+    uint32_t group_count;
+    uint32_t names_size;
+    uint32_t byte_order;
+};
+
+inline constexpr char kSnapshotMagic[8] = {'U', 'M', 'S', 'N', 'A', 'P', '0', '1'};
+inline constexpr uint32_t kByteOrderMark = 0x01020304;
+
+// A journal starts with a JournalHeader; after it come records, each a
+// fixed JournalRecord followed by name_length name bytes (native byte
+// order). The length is 32-bit so any name kept in memory replays unchanged.
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+};
+
+inline constexpr char kJournalMagic[8] = {'U', 'M', 'J', 'R', 'N', 'L', '0', '1'};
+inline constexpr uint32_t kJournalVersion = 1;
+
+struct JournalRecord {
+    uint8_t op;
+    uint8_t reserved[3];
+    uint32_t name_length;
+    int32_t id;
+    int32_t group_id;
+};
+
+inline constexpr uint8_t kJournalCreateUser = 1;
+inline constexpr uint8_t kJournalDeleteUser = 2;
+inline constexpr uint8_t kJournalCreateGroup = 3;
+inline constexpr uint8_t kJournalDeleteGroup = 4;
+
+enum class UserStatus { Ok, UserExists, UserNotFound, GroupExists, GroupNotFound };
+
 class UserManager {
 public:
+    explicit UserManager(std::ostream& out = std::cout) : out_(out) {}
+    UserManager(const UserManager&) = delete;
+    UserManager& operator=(const UserManager&) = delete;
+
     void create_user(int user_id, const std::string& name, int group_id = -1);
     void delete_user(int user_id);
     void create_group(int group_id);
@@ -50,238 +430,956 @@ public:
     void print_all_groups() const;
     void print_group(int group_id) const;
 
+    void reserve(size_t users, size_t groups);
+
+    // Writes the whole state as a columnar binary snapshot. When a journal
+    // is open it is truncated afterwards, since the snapshot now covers it.
+    bool save_snapshot(const std::string& path);
+    // Replaces the current state with a snapshot written by save_snapshot.
+    // Refused while a journal is open: that journal describes the state
+    // being replaced. Recovery is load_snapshot, replay_journal, then
+    // open_journal on the same file to keep appending to it.
+    bool load_snapshot(const std::string& path);
+    // Appends every successful change to path from now on.
+    bool open_journal(const std::string& path);
+    // Applies the changes recorded in a journal; a torn last record is ignored.
+    bool replay_journal(const std::string& path);
+    void flush_journal();
+
 private:
-    std::map<int, std::shared_ptr<User>> users_;
-    std::map<int, std::shared_ptr<Group>> groups_;
+    struct FileCloser {
+        void operator()(std::FILE* file) const { std::fclose(file); }
+    };
+
+    std::ostream& out_;
+    ObjectPool<User> user_pool_;
+    ObjectPool<Group> group_pool_;
+    NamePool names_;
+    FlatIdMap<Handle> users_;
+    FlatIdMap<Handle> groups_;
+    std::unique_ptr<std::FILE, FileCloser> journal_;
+    std::string journal_path_;
+
+    Handle find_group(int group_id) const;
+    Handle find_user(int user_id) const;
+
+    void attach_user(Handle user, Handle group);
+    void detach_user(Handle user);
+
+    // Silent state changes shared by the public commands and journal replay.
+    UserStatus apply_create_user(int user_id, std::string_view name, int group_id);
+    UserStatus apply_delete_user(int user_id);
+    UserStatus apply_create_group(int group_id);
+    UserStatus apply_delete_group(int group_id);
 
-    std::shared_ptr<Group> find_group(int group_id) const;
-    std::shared_ptr<User> find_user(int user_id) const;
+    void clear();
+    void journal_append(uint8_t op, int id, int group_id = -1, std::string_view name = {});
+    bool write_journal_header();
+    // Empties the open journal, once the current state is its new baseline.
+    // Reports through out_ and stops journaling if the file cannot be reopened.
+    void restart_journal();
 };
 
 
-void User::set_group(const std::shared_ptr<Group>& group) {
-    if (auto current_group = group_.lock()) {
-        current_group->remove_user(shared_from_this());
-    }
+void UserManager::attach_user(Handle user, Handle group) {
+    detach_user(user);
 
-    group_ = group;
-    if (group) {
-        group->add_user(shared_from_this());
-    }
+    auto& members = group_pool_[group].users_;
+    user_pool_[user].group_ = group;
+    user_pool_[user].group_slot_ = static_cast<uint32_t>(members.size());
+    members.push_back(user);
 }
 
-void User::remove_group() {
-    if (auto g = group_.lock()) {
-        g->remove_user(shared_from_this());
-    }
-    group_.reset();
+void UserManager::detach_user(Handle user) {
+    User& u = user_pool_[user];
+    if (u.group_ == kNoHandle) return;
+
+    auto& members = group_pool_[u.group_].users_;
+    Handle last = members.back();
+    members[u.group_slot_] = last;
+    user_pool_[last].group_slot_ = u.group_slot_;
+    members.pop_back();
+    u.group_ = kNoHandle;
+}
+
+void UserManager::reserve(size_t users, size_t groups) {
+    user_pool_.reserve(users);
+    users_.reserve(users);
+    group_pool_.reserve(groups);
+    groups_.reserve(groups);
 }
 
+void UserManager::clear() {
+    user_pool_ = {};
+    group_pool_ = {};
+    names_ = {};
+    users_ = {};
+    groups_ = {};
+}
 
-std::vector<std::shared_ptr<User>> Group::users() const {
-    std::vector<std::shared_ptr<User>> valid_users;
-    for (const auto& user : users_) {
-        if (auto u = user.lock()) {
-            valid_users.push_back(u);
-        }
+UserStatus UserManager::apply_create_user(int user_id, std::string_view name, int group_id) {
+    if (users_.contains(user_id)) return UserStatus::UserExists;
+    Handle group = kNoHandle;
+    if (group_id != -1 && (group = find_group(group_id)) == kNoHandle) {
+        return UserStatus::GroupNotFound;
+    }
+
+    Handle user = user_pool_.acquire();
+    User& u = user_pool_[user];
+    u.id_ = user_id;
+    u.name_.assign(name, names_);
+    u.group_ = kNoHandle;
+    users_.try_emplace(user_id, user);
+
+    if (group != kNoHandle) {
+        attach_user(user, group);
     }
-    return valid_users;
+    return UserStatus::Ok;
 }
 
-void Group::add_user(const std::shared_ptr<User>& user) {
-    users_.emplace_back(user);
+UserStatus UserManager::apply_delete_user(int user_id) {
+    Handle user = find_user(user_id);
+    if (user == kNoHandle) return UserStatus::UserNotFound;
+
+    detach_user(user);
+    user_pool_[user].name_.release(names_);
+    user_pool_.release(user);
+    users_.erase(user_id);
+    return UserStatus::Ok;
 }
 
-void Group::remove_user(const std::shared_ptr<User>& user) {
-    users_.erase(
-            std::remove_if(users_.begin(), users_.end(),
-                           [&](const auto& weak_user) {
-                               auto u = weak_user.lock();
-                               return u->id() == user->id();
-                           }),
-            users_.end());
+UserStatus UserManager::apply_create_group(int group_id) {
+    if (groups_.contains(group_id)) return UserStatus::GroupExists;
+
+    Handle group = group_pool_.acquire();
+    group_pool_[group].id_ = group_id;
+    group_pool_[group].users_.clear();
+    groups_.try_emplace(group_id, group);
+    return UserStatus::Ok;
 }
 
-void UserManager::create_user(int user_id, const std::string& name, int group_id) {
-    if (users_.count(user_id)) {
-        std::cout << "Error: User " << user_id << " already exists\n";
-        return;
-    }
-    if (group_id != -1 && find_group(group_id) == nullptr) {
-        std::cout << "Error: Group " << group_id << " not found\n";
-        return;
+UserStatus UserManager::apply_delete_group(int group_id) {
+    Handle group = find_group(group_id);
+    if (group == kNoHandle) return UserStatus::GroupNotFound;
+
+    auto& members = group_pool_[group].users_;
+    for (Handle user : members) {
+        user_pool_[user].group_ = kNoHandle;
     }
+    members.clear();
 
-    auto user = std::make_shared<User>(user_id, name);
-    users_[user_id] = user;
+    group_pool_.release(group);
+    groups_.erase(group_id);
+    return UserStatus::Ok;
+}
 
-    if (group_id != -1) {
-        if (auto group = find_group(group_id)) {
-            user->set_group(group);
-        }
+void UserManager::create_user(int user_id, const std::string& name, int group_id) {
+    switch (apply_create_user(user_id, name, group_id)) {
+        case UserStatus::UserExists:
+            out_ << "Error: User " << user_id << " already exists\n";
+            break;
+        case UserStatus::GroupNotFound:
+            out_ << "Error: Group " << group_id << " not found\n";
+            break;
+        default:
+            journal_append(kJournalCreateUser, user_id, group_id, name);
+            break;
     }
 }
 
 void UserManager::delete_user(int user_id) {
-    auto it = users_.find(user_id);
-    if (it == users_.end()) {
-        std::cout << "Error: User " << user_id << " not found\n";
+    if (apply_delete_user(user_id) != UserStatus::Ok) {
+        out_ << "Error: User " << user_id << " not found\n";
         return;
     }
-
-    it->second->remove_group();
-    users_.erase(it);
-    std::cout << "User " << user_id << " deleted\n";
+    journal_append(kJournalDeleteUser, user_id);
+    out_ << "User " << user_id << " deleted\n";
 }
 
 void UserManager::create_group(int group_id) {
-    if (groups_.count(group_id)) {
-        std::cout << "Error: Group " << group_id << " already exists\n";
+    if (apply_create_group(group_id) != UserStatus::Ok) {
+        out_ << "Error: Group " << group_id << " already exists\n";
         return;
     }
-
-    groups_[group_id] = std::make_shared<Group>(group_id);
-    std::cout << "Group " << group_id << " created\n";
+    journal_append(kJournalCreateGroup, group_id);
+    out_ << "Group " << group_id << " created\n";
 }
 
 void UserManager::delete_group(int group_id) {
-    auto it = groups_.find(group_id);
-    if (it == groups_.end()) {
-        std::cout << "Error: Group " << group_id << " not found\n";
+    if (apply_delete_group(group_id) != UserStatus::Ok) {
+        out_ << "Error: Group " << group_id << " not found\n";
         return;
     }
-
-    auto group = it->second;
-    for (auto& user : group->users()) {
-        user->remove_group();
-    }
-
-    groups_.erase(it);
-    std::cout << "Group " << group_id << " deleted\n";
+    journal_append(kJournalDeleteGroup, group_id);
+    out_ << "Group " << group_id << " deleted\n";
 }
 
 void UserManager::print_all_users() const {
     if (users_.empty()) {
-        std::cout << "No users found\n";
+        out_ << "No users found\n";
         return;
     }
 
-    for (const auto& [id, user] : users_) {
+    for (int id : users_.sorted_keys()) {
         print_user(id);
     }
 }
 
 void UserManager::print_user(int user_id) const {
-    if (auto user = find_user(user_id)) {
-        std::cout << "User ID: " << user_id
-                  << "\nName: " << user->name()
-                  << "\nGroup: ";
-        if (auto g = user->group()) {
-            std::cout << g->id();
+    Handle user = find_user(user_id);
+    if (user != kNoHandle) {
+        const User& u = user_pool_[user];
+        out_ << "User ID: " << user_id
+             << "\nName: " << u.name_.view(names_)
+             << "\nGroup: ";
+        if (u.group_ != kNoHandle) {
+            out_ << group_pool_[u.group_].id();
         } else {
-            std::cout << "None";
+            out_ << "None";
         }
-        std::cout << "\n-------------\n";
+        out_ << "\n-------------\n";
     } else {
-        std::cout << "Error: User " << user_id << " not found\n";
+        out_ << "Error: User " << user_id << " not found\n";
     }
 }
 
 void UserManager::print_all_groups() const {
     if (groups_.empty()) {
-        std::cout << "No groups found\n";
+        out_ << "No groups found\n";
         return;
     }
 
-    for (const auto& [id, group] : groups_) {
+    for (int id : groups_.sorted_keys()) {
         print_group(id);
     }
 }
 
 void UserManager::print_group(int group_id) const {
-    if (auto group = find_group(group_id)) {
-        std::cout << "Group ID: " << group_id << "\nMembers:";
-        auto members = group->users();
+    Handle group = find_group(group_id);
+    if (group != kNoHandle) {
+        out_ << "Group ID: " << group_id << "\nMembers:";
+        const auto& members = group_pool_[group].users();
         if (members.empty()) {
-            std::cout << " None";
+            out_ << " None";
         } else {
-            for (const auto& user : members) {
-                std::cout << "\n- " << user->name() << " (ID: " << user->id() << ")";
+            for (Handle user : members) {
+                const User& u = user_pool_[user];
+                out_ << "\n- " << u.name_.view(names_) << " (ID: " << u.id() << ")";
             }
         }
-        std::cout << "\n-------------\n";
+        out_ << "\n-------------\n";
     } else {
-        std::cout << "Error: Group " << group_id << " not found\n";
+        out_ << "Error: Group " << group_id << " not found\n";
     }
 }
 
-std::shared_ptr<Group> UserManager::find_group(int group_id) const {
-    auto it = groups_.find(group_id);
-    return it != groups_.end() ? it->second : nullptr;
+Handle UserManager::find_group(int group_id) const {
+    auto group = groups_.find(group_id);
+    return group ? *group : kNoHandle;
+}
+
+Handle UserManager::find_user(int user_id) const {
+    auto user = users_.find(user_id);
+    return user ? *user : kNoHandle;
+}
+
+bool UserManager::save_snapshot(const std::string& path) {
+    std::vector<int> user_ids = users_.sorted_keys();
+    std::vector<int> group_ids = groups_.sorted_keys();
+    std::vector<int32_t> user_groups;
+    std::vector<uint32_t> name_offsets;
+    std::string names;
+    user_groups.reserve(user_ids.size());
+    name_offsets.reserve(user_ids.size() + 1);
+
+    for (int id : user_ids) {
+        const User& u = user_pool_[*users_.find(id)];
+        user_groups.push_back(u.group_ != kNoHandle ? group_pool_[u.group_].id() : -1);
+        name_offsets.push_back(static_cast<uint32_t>(names.size()));
+        names.append(u.name_.view(names_));
+    }
+    name_offsets.push_back(static_cast<uint32_t>(names.size()));
+
+    SnapshotHeader header{};
+    std::copy(std::begin(kSnapshotMagic), std::end(kSnapshotMagic), header.magic);
+    header.user_count = static_cast<uint32_t>(user_ids.size());
+    header.group_count = static_cast<uint32_t>(group_ids.size());
+    header.names_size = static_cast<uint32_t>(names.size());
+    header.byte_order = kByteOrderMark;
+
+    // Written next to the target and renamed, so a crash never leaves a
+    // half-written snapshot under the real name.
+    std::string temp_path = path + ".tmp";
+    std::unique_ptr<std::FILE, FileCloser> file(std::fopen(temp_path.c_str(), "wb"));
+    if (!file) {
+        out_ << "Error: cannot write snapshot " << path << "\n";
+        return false;
+    }
+    static_assert(sizeof(int) == sizeof(int32_t));
+    // Empty sections are skipped: an empty vector's data() may be null,
+    // which fwrite does not accept even for a zero count.
+    auto write = [&](const void* data, size_t size, size_t count) {
+        return count == 0 || std::fwrite(data, size, count, file.get()) == count;
+    };
+    bool ok = write(&header, sizeof(header), 1);
+    ok = ok && write(group_ids.data(), sizeof(int32_t), group_ids.size());
+    ok = ok && write(user_ids.data(), sizeof(int32_t), user_ids.size());
+    ok = ok && write(user_groups.data(), sizeof(int32_t), user_groups.size());
+    ok = ok && write(name_offsets.data(), sizeof(uint32_t), name_offsets.size());
+    ok = ok && write(names.data(), 1, names.size());
+    ok = ok && sync_file(file.get());
+    ok = std::fclose(file.release()) == 0 && ok;
+    if (!ok || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        out_ << "Error: cannot write snapshot " << path << "\n";
+        return false;
+    }
+    // The journal may only be emptied once the snapshot replacing it is
+    // durable, data and directory entry both; otherwise a crash could lose
+    // the two together.
+    if (!sync_parent_directory(path)) {
+        out_ << "Error: cannot sync snapshot " << path << "\n";
+        return false;
+    }
+
+    restart_journal();
+    return true;
+}
+
+bool UserManager::load_snapshot(const std::string& path) {
+    if (journal_) {
+        out_ << "Error: cannot load a snapshot while journal " << journal_path_ << " is open\n";
+        return false;
+    }
+    MappedFile file(path);
+    SnapshotHeader header{};
+    if (!file.ok() || file.size() < sizeof(header)) {
+        out_ << "Error: cannot read snapshot " << path << "\n";
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    uint64_t expected = sizeof(header) +
+                        4ull * header.group_count +
+                        8ull * header.user_count +
+                        4ull * (header.user_count + 1ull) +
+                        header.names_size;
+    if (!std::equal(std::begin(kSnapshotMagic), std::end(kSnapshotMagic), header.magic) ||
+        header.byte_order != kByteOrderMark || file.size() != expected) {
+        out_ << "Error: invalid snapshot " << path << "\n";
+        return false;
+    }
+
+    auto* group_ids = reinterpret_cast<const int32_t*>(file.data() + sizeof(header));
+    auto* user_ids = group_ids + header.group_count;
+    auto* user_groups = user_ids + header.user_count;
+    auto* name_offsets = reinterpret_cast<const uint32_t*>(user_groups + header.user_count);
+    auto* names = reinterpret_cast<const char*>(name_offsets + header.user_count + 1);
+
+    clear();
+    reserve(header.user_count, header.group_count);
+    for (uint32_t i = 0; i < header.group_count; ++i) {
+        apply_create_group(group_ids[i]);
+    }
+    for (uint32_t i = 0; i < header.user_count; ++i) {
+        uint32_t begin = name_offsets[i];
+        uint32_t end = name_offsets[i + 1];
+        if (begin > end || end > header.names_size ||
+            apply_create_user(user_ids[i], {names + begin, end - begin}, user_groups[i]) != UserStatus::Ok) {
+            clear();
+            out_ << "Error: invalid snapshot " << path << "\n";
+            return false;
+        }
+    }
+    return true;
 }
 
-std::shared_ptr<User> UserManager::find_user(int user_id) const {
-    auto it = users_.find(user_id);
-    return it != users_.end() ? it->second : nullptr;
+// Checks the magic, version and byte order a journal starts with.
+bool valid_journal_header(const char* data, size_t size) {
+    JournalHeader header;
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, data, sizeof(header));
+    return std::equal(std::begin(kJournalMagic), std::end(kJournalMagic), header.magic) &&
+           header.version == kJournalVersion && header.byte_order == kByteOrderMark;
 }
 
-int main() {
+bool UserManager::open_journal(const std::string& path) {
+    // Append mode keeps every write at the end; reading is only used to
+    // check that an existing file really is a journal in this format.
+    std::unique_ptr<std::FILE, FileCloser> file(std::fopen(path.c_str(), "a+b"));
+    if (!file) {
+        out_ << "Error: cannot open journal " << path << "\n";
+        return false;
+    }
+    std::fseek(file.get(), 0, SEEK_END);
+    bool empty = std::ftell(file.get()) == 0;
+    if (!empty) {
+        char header[sizeof(JournalHeader)];
+        std::rewind(file.get());
+        size_t read = std::fread(header, 1, sizeof(header), file.get());
+        if (!valid_journal_header(header, read)) {
+            out_ << "Error: invalid journal " << path << "\n";
+            return false;
+        }
+        // A stream switching from reading to writing needs a seek first.
+        std::fseek(file.get(), 0, SEEK_END);
+    }
+    journal_ = std::move(file);
+    journal_path_ = path;
+    if (empty && !write_journal_header()) {
+        journal_.reset();
+        out_ << "Error: cannot open journal " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool UserManager::replay_journal(const std::string& path) {
+    MappedFile file(path);
+    if (!file.ok()) {
+        out_ << "Error: cannot read journal " << path << "\n";
+        return false;
+    }
+
+    // A stale, foreign or older-format file is rejected up front rather
+    // than applied as garbage.
+    if (!valid_journal_header(file.data(), file.size())) {
+        out_ << "Error: invalid journal " << path << "\n";
+        return false;
+    }
+
+    const char* cursor = file.data() + sizeof(JournalHeader);
+    const char* end = file.data() + file.size();
+    while (static_cast<size_t>(end - cursor) >= sizeof(JournalRecord)) {
+        JournalRecord record;
+        std::memcpy(&record, cursor, sizeof(record));
+        if (record.reserved[0] != 0 || record.reserved[1] != 0 || record.reserved[2] != 0) {
+            out_ << "Error: invalid journal " << path << "\n";
+            return false;
+        }
+        if (static_cast<size_t>(end - cursor) < sizeof(record) + record.name_length) break;
+        std::string_view name(cursor + sizeof(record), record.name_length);
+        cursor += sizeof(record) + record.name_length;
+
+        switch (record.op) {
+            case kJournalCreateUser: apply_create_user(record.id, name, record.group_id); break;
+            case kJournalDeleteUser: apply_delete_user(record.id); break;
+            case kJournalCreateGroup: apply_create_group(record.id); break;
+            case kJournalDeleteGroup: apply_delete_group(record.id); break;
+            default:
+                out_ << "Error: invalid journal " << path << "\n";
+                return false;
+        }
+    }
+    return true;
+}
+
+void UserManager::restart_journal() {
+    if (journal_) {
+        journal_.reset(std::fopen(journal_path_.c_str(), "wb"));
+        if (!journal_ || !write_journal_header() || !sync_file(journal_.get())) {
+            journal_.reset();
+            out_ << "Error: cannot restart journal " << journal_path_ << "; journaling stopped\n";
+        }
+    }
+}
+
+bool UserManager::write_journal_header() {
+    JournalHeader header{};
+    std::copy(std::begin(kJournalMagic), std::end(kJournalMagic), header.magic);
+    header.version = kJournalVersion;
+    header.byte_order = kByteOrderMark;
+    return std::fwrite(&header, sizeof(header), 1, journal_.get()) == 1;
+}
+
+void UserManager::flush_journal() {
+    if (journal_) std::fflush(journal_.get());
+}
+
+void UserManager::journal_append(uint8_t op, int id, int group_id, std::string_view name) {
+    if (!journal_) return;
+
+    JournalRecord record{op, {}, static_cast<uint32_t>(name.size()), id, group_id};
+    std::fwrite(&record, sizeof(record), 1, journal_.get());
+    if (!name.empty()) std::fwrite(name.data(), 1, name.size(), journal_.get());
+}
+
+// Thread-safe counterpart of UserManager for multi-threaded front ends.
+// Users and groups are spread over shards by id, and every shard has its
+// own reader-writer lock. Lookups take a single shared lock. Updates that
+// touch several shards lock them exclusively in ascending shard order;
+// delete_group, whose members may live in any shard, locks all of them.
+// Invariant: a user's group_id is g exactly when the user is in g's members.
+class ConcurrentUserManager {
+public:
+    using Status = UserStatus;
+
+    struct UserInfo {
+        int id;
+        std::string name;
+        int group_id;  // -1 when the user has no group
+    };
+
+    explicit ConcurrentUserManager(size_t shard_count = 64) : shards_(shard_count) {}
+
+    Status create_user(int user_id, std::string_view name, int group_id = -1);
+    Status delete_user(int user_id);
+    Status set_user_group(int user_id, int group_id);
+    Status create_group(int group_id);
+    Status delete_group(int group_id);
+
+    std::optional<UserInfo> find_user(int user_id) const;
+    void print_user(int user_id, std::ostream& out) const;
+    void print_group(int group_id, std::ostream& out) const;
+
+private:
+    struct UserEntry {
+        CompactName name;
+        int group_id = -1;
+    };
+
+    struct GroupEntry {
+        FlatIdMap<bool> members;
+    };
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        FlatIdMap<UserEntry> users;
+        FlatIdMap<GroupEntry> groups;
+        NamePool names;
+    };
+
+    // Exclusive locks on up to three shards, taken in ascending index order
+    // so that concurrent multi-shard updates cannot deadlock.
+    class ShardLocks {
+    public:
+        ShardLocks(const ConcurrentUserManager& manager, std::array<size_t, 3> indices) {
+            std::sort(indices.begin(), indices.end());
+            auto last = std::unique(indices.begin(), indices.end());
+            for (auto it = indices.begin(); it != last; ++it) {
+                locks_[count_++] = std::unique_lock(manager.shards_[*it].mutex);
+            }
+        }
+
+    private:
+        std::array<std::unique_lock<std::shared_mutex>, 3> locks_;
+        size_t count_ = 0;
+    };
+
+    std::vector<Shard> shards_;
+
+    size_t shard_index(int id) const {
+        return static_cast<size_t>(
+                (static_cast<uint64_t>(static_cast<uint32_t>(id)) * 0x9E3779B97F4A7C15ull) >> 32) %
+               shards_.size();
+    }
+
+    Shard& shard_of(int id) { return shards_[shard_index(id)]; }
+    const Shard& shard_of(int id) const { return shards_[shard_index(id)]; }
+
+    // Group of a user read under a shared lock, or nullopt if it does not
+    // exist. The caller revalidates it once the exclusive locks are held.
+    std::optional<int> peek_group(int user_id) const;
+};
+
+
+std::optional<int> ConcurrentUserManager::peek_group(int user_id) const {
+    const Shard& shard = shard_of(user_id);
+    std::shared_lock lock(shard.mutex);
+    auto user = shard.users.find(user_id);
+    if (!user) return std::nullopt;
+    return user->group_id;
+}
+
+ConcurrentUserManager::Status ConcurrentUserManager::create_user(int user_id, std::string_view name,
+                                                                 int group_id) {
+    size_t user_shard = shard_index(user_id);
+    size_t group_shard = group_id != -1 ? shard_index(group_id) : user_shard;
+    ShardLocks locks(*this, {user_shard, group_shard, user_shard});
+
+    Shard& shard = shards_[user_shard];
+    if (shard.users.contains(user_id)) return Status::UserExists;
+
+    GroupEntry* group = nullptr;
+    if (group_id != -1) {
+        group = shards_[group_shard].groups.find(group_id);
+        if (!group) return Status::GroupNotFound;
+    }
+
+    auto [user, inserted] = shard.users.try_emplace(user_id, UserEntry{});
+    user->name.assign(name, shard.names);
+    user->group_id = group_id;
+    if (group) group->members.try_emplace(user_id, true);
+    return Status::Ok;
+}
+
+ConcurrentUserManager::Status ConcurrentUserManager::delete_user(int user_id) {
+    size_t user_shard = shard_index(user_id);
+    while (true) {
+        auto group_id = peek_group(user_id);
+        if (!group_id) return Status::UserNotFound;
+
+        size_t group_shard = *group_id != -1 ? shard_index(*group_id) : user_shard;
+        ShardLocks locks(*this, {user_shard, group_shard, user_shard});
+
+        Shard& shard = shards_[user_shard];
+        auto user = shard.users.find(user_id);
+        if (!user) return Status::UserNotFound;
+        if (user->group_id != *group_id) continue;  // moved meanwhile, lock the new group
+
+        if (*group_id != -1) {
+            shards_[group_shard].groups.find(*group_id)->members.erase(user_id);
+        }
+        user->name.release(shard.names);
+        shard.users.erase(user_id);
+        return Status::Ok;
+    }
+}
+
+ConcurrentUserManager::Status ConcurrentUserManager::set_user_group(int user_id, int group_id) {
+    size_t user_shard = shard_index(user_id);
+    size_t new_shard = group_id != -1 ? shard_index(group_id) : user_shard;
+    while (true) {
+        auto old_id = peek_group(user_id);
+        if (!old_id) return Status::UserNotFound;
+
+        size_t old_shard = *old_id != -1 ? shard_index(*old_id) : user_shard;
+        ShardLocks locks(*this, {user_shard, old_shard, new_shard});
+
+        auto user = shards_[user_shard].users.find(user_id);
+        if (!user) return Status::UserNotFound;
+        if (user->group_id != *old_id) continue;
+
+        GroupEntry* group = nullptr;
+        if (group_id != -1) {
+            group = shards_[new_shard].groups.find(group_id);
+            if (!group) return Status::GroupNotFound;
+        }
+
+        if (*old_id != -1) {
+            shards_[old_shard].groups.find(*old_id)->members.erase(user_id);
+        }
+        user->group_id = group_id;
+        if (group) group->members.try_emplace(user_id, true);
+        return Status::Ok;
+    }
+}
+
+ConcurrentUserManager::Status ConcurrentUserManager::create_group(int group_id) {
+    Shard& shard = shard_of(group_id);
+    std::unique_lock lock(shard.mutex);
+    auto [group, inserted] = shard.groups.try_emplace(group_id, GroupEntry{});
+    return inserted ? Status::Ok : Status::GroupExists;
+}
+
+ConcurrentUserManager::Status ConcurrentUserManager::delete_group(int group_id) {
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    locks.reserve(shards_.size());
+    for (auto& shard : shards_) {
+        locks.emplace_back(shard.mutex);
+    }
+
+    Shard& shard = shard_of(group_id);
+    auto group = shard.groups.find(group_id);
+    if (!group) return Status::GroupNotFound;
+
+    group->members.for_each([this](int user_id, bool) {
+        shard_of(user_id).users.find(user_id)->group_id = -1;
+    });
+    shard.groups.erase(group_id);
+    return Status::Ok;
+}
+
+std::optional<ConcurrentUserManager::UserInfo> ConcurrentUserManager::find_user(int user_id) const {
+    const Shard& shard = shard_of(user_id);
+    std::shared_lock lock(shard.mutex);
+    auto user = shard.users.find(user_id);
+    if (!user) return std::nullopt;
+    return UserInfo{user_id, std::string(user->name.view(shard.names)), user->group_id};
+}
+
+void ConcurrentUserManager::print_user(int user_id, std::ostream& out) const {
+    if (auto user = find_user(user_id)) {
+        out << "User ID: " << user_id
+            << "\nName: " << user->name
+            << "\nGroup: ";
+        if (user->group_id != -1) {
+            out << user->group_id;
+        } else {
+            out << "None";
+        }
+        out << "\n-------------\n";
+    } else {
+        out << "Error: User " << user_id << " not found\n";
+    }
+}
+
+void ConcurrentUserManager::print_group(int group_id, std::ostream& out) const {
+    std::vector<int> members;
+    {
+        const Shard& shard = shard_of(group_id);
+        std::shared_lock lock(shard.mutex);
+        auto group = shard.groups.find(group_id);
+        if (!group) {
+            out << "Error: Group " << group_id << " not found\n";
+            return;
+        }
+        members = group->members.sorted_keys();
+    }
+
+    // Member shards are read after the group lock is released, so a user
+    // that left the group in between is skipped rather than printed.
+    out << "Group ID: " << group_id << "\nMembers:";
+    bool any = false;
+    for (int user_id : members) {
+        auto user = find_user(user_id);
+        if (!user || user->group_id != group_id) continue;
+        out << "\n- " << user->name << " (ID: " << user->id << ")";
+        any = true;
+    }
+    if (!any) out << " None";
+    out << "\n-------------\n";
+}
+
+// Measures ConcurrentUserManager throughput for 1..max_threads threads on a
+// read-mostly mix: 90% find_user, 6% set_user_group, 4% delete+create.
+// A single shard behaves like one global reader-writer lock.
+int run_concurrency_benchmark(unsigned max_threads) {
+    constexpr int kUsers = 200'000;
+    constexpr int kGroups = 1'000;
+    constexpr size_t kOpsPerThread = 500'000;
+
+    for (size_t shards : {size_t{1}, size_t{64}}) {
+        for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+            ConcurrentUserManager manager(shards);
+            for (int g = 0; g < kGroups; ++g) manager.create_group(g);
+            for (int u = 0; u < kUsers; ++u) manager.create_user(u, "user", u % kGroups);
+
+            std::atomic<size_t> found{0};
+            auto worker = [&](unsigned seed) {
+                std::mt19937 rng(seed);
+                std::uniform_int_distribution<int> user_dist(0, kUsers - 1);
+                std::uniform_int_distribution<int> group_dist(0, kGroups - 1);
+                std::uniform_int_distribution<int> op_dist(0, 99);
+                size_t local_found = 0;
+                for (size_t i = 0; i < kOpsPerThread; ++i) {
+                    int op = op_dist(rng);
+                    int user = user_dist(rng);
+                    if (op < 90) {
+                        local_found += manager.find_user(user).has_value();
+                    } else if (op < 96) {
+                        manager.set_user_group(user, group_dist(rng));
+                    } else {
+                        manager.delete_user(user);
+                        manager.create_user(user, "user", group_dist(rng));
+                    }
+                }
+                found += local_found;
+            };
+
+            auto started = std::chrono::steady_clock::now();
+            std::vector<std::thread> pool;
+            for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker, t + 1);
+            for (auto& thread : pool) thread.join();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+
+            double ops = static_cast<double>(kOpsPerThread) * threads;
+            std::printf("shards=%-3zu threads=%-3u %12.0f ops/sec (%zu hits)\n",
+                        shards, threads, ops / elapsed.count(), found.load());
+        }
+    }
+    return 0;
+}
+
+class CommandTokenizer {
+public:
+    explicit CommandTokenizer(std::string_view line) : rest_(line) {}
+
+    std::string_view next() {
+        size_t begin = rest_.find_first_not_of(" \t\r");
+        if (begin == std::string_view::npos) {
+            rest_ = {};
+            return {};
+        }
+        size_t end = rest_.find_first_of(" \t\r", begin);
+        if (end == std::string_view::npos) end = rest_.size();
+        auto token = rest_.substr(begin, end - begin);
+        rest_.remove_prefix(end);
+        return token;
+    }
+
+    int next_int() {
+        int value;
+        if (!try_next_int(value)) throw std::invalid_argument("expected integer");
+        return value;
+    }
+
+    bool try_next_int(int& value) {
+        auto token = next();
+        if (token.empty()) return false;
+        auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+        return ec == std::errc() && ptr == token.data() + token.size();
+    }
+
+private:
+    std::string_view rest_;
+};
+
+// Returns false when the command asks to stop reading input.
+bool execute_command(UserManager& manager, std::string_view line, std::ostream& out) {
+    CommandTokenizer tokens(line);
+    auto cmd = tokens.next();
+
+    if (cmd == "exit") return false;
+
+    if (cmd == "createUser") {
+        int id = tokens.next_int();
+        std::string name(tokens.next());
+        int group = -1;
+        if (!tokens.try_next_int(group)) group = -1;
+        manager.create_user(id, name, group);
+    }
+    else if (cmd == "deleteUser") {
+        manager.delete_user(tokens.next_int());
+    }
+    else if (cmd == "allUsers") {
+        manager.print_all_users();
+    }
+    else if (cmd == "getUser") {
+        manager.print_user(tokens.next_int());
+    }
+    else if (cmd == "createGroup") {
+        manager.create_group(tokens.next_int());
+    }
+    else if (cmd == "deleteGroup") {
+        manager.delete_group(tokens.next_int());
+    }
+    else if (cmd == "allGroups") {
+        manager.print_all_groups();
+    }
+    else if (cmd == "getGroup") {
+        manager.print_group(tokens.next_int());
+    }
+    else if (cmd == "saveSnapshot") {
+        if (manager.save_snapshot(std::string(tokens.next()))) out << "Snapshot saved\n";
+    }
+    else if (cmd == "loadSnapshot") {
+        if (manager.load_snapshot(std::string(tokens.next()))) out << "Snapshot loaded\n";
+    }
+    else if (cmd == "openJournal") {
+        if (manager.open_journal(std::string(tokens.next()))) out << "Journal opened\n";
+    }
+    else if (cmd == "replayJournal") {
+        if (manager.replay_journal(std::string(tokens.next()))) out << "Journal replayed\n";
+    }
+    else if (cmd == "help") {
+        out << "createUser <id> <name> [group], deleteUser <id>, allUsers, getUser <id>\n"
+               "createGroup <id>, deleteGroup <id>, allGroups, getGroup <id>\n"
+               "saveSnapshot <path>, loadSnapshot <path>, openJournal <path>, replayJournal <path>, exit\n"
+               "Recovery: loadSnapshot <snapshot>, replayJournal <journal>, then openJournal <journal>.\n"
+               "loadSnapshot is refused once a journal is open; saveSnapshot empties the open journal.\n";
+    }
+    else {
+        out << "Unknown command\n";
+    }
+    return true;
+}
+
+int run_interactive() {
     UserManager manager;
     std::string line;
 
     while (true) {
         std::cout << "> ";
-        std::getline(std::cin, line);
-        std::istringstream iss(line);
-        std::string cmd;
-        iss >> cmd;
-
-        if (cmd == "exit") break;
+        if (!std::getline(std::cin, line)) break;
 
         try {
-            if (cmd == "createUser") {
-                int id, group = -1;
-                std::string name;
-                iss >> id >> name;
-                if (iss >> group) {}
-                manager.create_user(id, name, group);
-            }
-            else if (cmd == "deleteUser") {
-                int id;
-                iss >> id;
-                manager.delete_user(id);
-            }
-            else if (cmd == "allUsers") {
-                manager.print_all_users();
-            }
-            else if (cmd == "getUser") {
-                int id;
-                iss >> id;
-                manager.print_user(id);
-            }
-            else if (cmd == "createGroup") {
-                int id;
-                iss >> id;
-                manager.create_group(id);
-            }
-            else if (cmd == "deleteGroup") {
-                int id;
-                iss >> id;
-                manager.delete_group(id);
-            }
-            else if (cmd == "allGroups") {
-                manager.print_all_groups();
-            }
-            else if (cmd == "getGroup") {
-                int id;
-                iss >> id;
-                manager.print_group(id);
-            }
-            else {
-                std::cout << "Unknown command\n";
-            }
+            if (!execute_command(manager, line, std::cout)) break;
         } catch (...) {
             std::cout << "Invalid command format\n";
         }
+        manager.flush_journal();
+    }
+    return 0;
+}
+
+// Non-interactive mode for provisioning scripts: input is read in large
+// chunks, output is collected in one buffer and written in big blocks.
+int run_batch(std::FILE* in) {
+    constexpr size_t kChunkSize = 1 << 20;
+    constexpr size_t kOutputFlushSize = 4 << 20;
+
+    std::ostringstream out;
+    UserManager manager(out);
+    std::string pending;
+    std::vector<char> chunk(kChunkSize);
+    size_t commands = 0;
+    bool done = false;
+
+    auto flush_output = [&out]() {
+        auto text = out.str();
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        out.str({});
+    };
+
+    auto process_line = [&](std::string_view line) {
+        auto start = line.find_first_not_of(" \t\r");
+        if (start == std::string_view::npos || line[start] == '#') return;
+        ++commands;
+        try {
+            if (!execute_command(manager, line, out)) done = true;
+        } catch (...) {
+            out << "Invalid command format\n";
+        }
+        if (out.tellp() > static_cast<std::streamoff>(kOutputFlushSize)) flush_output();
+    };
+
+    auto started = std::chrono::steady_clock::now();
+    size_t read;
+    while (!done && (read = std::fread(chunk.data(), 1, chunk.size(), in)) > 0) {
+        pending.append(chunk.data(), read);
+
+        std::string_view view(pending);
+        size_t line_start = 0;
+        size_t newline;
+        while (!done && (newline = view.find('\n', line_start)) != std::string_view::npos) {
+            process_line(view.substr(line_start, newline - line_start));
+            line_start = newline + 1;
+        }
+        pending.erase(0, line_start);
+    }
+    if (!done && !pending.empty()) process_line(pending);
+    flush_output();
+    std::fflush(stdout);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+    double rate = elapsed.count() > 0 ? commands / elapsed.count() : 0.0;
+    std::fprintf(stderr, "Processed %zu commands in %.3f s (%.0f commands/sec)\n",
+                 commands, elapsed.count(), rate);
+    return 0;
+}
+
+// The benchmark suite includes this file and defines USERS_NO_MAIN.
+#ifndef USERS_NO_MAIN
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string_view(argv[1]) == "--bench-concurrent") {
+        unsigned max_threads = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2]))
+                                        : std::max(1u, std::thread::hardware_concurrency());
+        return run_concurrency_benchmark(std::max(1u, max_threads));
+    }
+    if (argc > 1 && std::string_view(argv[1]) == "--batch") {
+        if (argc < 3 || std::string_view(argv[2]) == "-") {
+            return run_batch(stdin);
+        }
+        std::FILE* in = std::fopen(argv[2], "rb");
+        if (!in) {
+            std::fprintf(stderr, "Error: cannot open %s\n", argv[2]);
+            return 1;
+        }
+        int rc = run_batch(in);
+        std::fclose(in);
+        return rc;
     }
+    return run_interactive();
 }
+#endif
@@ -0,0 +1,58 @@
+// Compile-time benchmark for the TypeList algorithms. Builds a list of
+// TYPELIST_BENCH_SIZE distinct types and queries TypeAt, IndexOf and
+// Contains for every element, then runs the bulk transforms over it. Only meant to be compiled, not linked:
+//   g++ -std=c++20 -fsyntax-only -ftime-report -DTYPELIST_BENCH_SIZE=300 compile_bench.cpp
+// compile_bench.sh runs it over a range of sizes.
+#include <utility>
+
+#include "main.cpp"
+
+#ifndef TYPELIST_BENCH_SIZE
+#define TYPELIST_BENCH_SIZE 300
+#endif
+
+namespace CompileBench {
+
+    template <int I>
+    struct BenchType {};
+
+    template <typename Sequence>
+    struct MakeBenchList;
+
+    template <int... Is>
+    struct MakeBenchList<std::integer_sequence<int, Is...>> {
+        using Result = TypeList<BenchType<Is>...>;
+    };
+
+    using BenchList = MakeBenchList<std::make_integer_sequence<int, TYPELIST_BENCH_SIZE>>::Result;
+
+    template <int I>
+    constexpr bool check_element() {
+        return std::is_same_v<typename TypeAt<I, BenchList>::Type, BenchType<I>> &&
+               IndexOf<BenchType<I>, BenchList>::value == I &&
+               Contains<BenchType<I>, BenchList>::value;
+    }
+
+    template <int... Is>
+    constexpr bool check_all(std::integer_sequence<int, Is...>) {
+        constexpr bool results[] = {check_element<Is>()...};
+        for (bool result : results) {
+            if (!result) return false;
+        }
+        return true;
+    }
+
+    static_assert(ListSize<BenchList>::value == TYPELIST_BENCH_SIZE);
+    static_assert(check_all(std::make_integer_sequence<int, TYPELIST_BENCH_SIZE>{}));
+    static_assert(!Contains<BenchType<-1>, BenchList>::value);
+
+    using DoubledList = Concat<BenchList, BenchList>::Result;
+    static_assert(std::is_same_v<Unique<DoubledList>::Result, BenchList>);
+    static_assert(std::is_same_v<Reverse<Reverse<BenchList>::Result>::Result, BenchList>);
+    static_assert(std::is_same_v<SortBy<SizeOf, BenchList>::Result, BenchList>);
+    static_assert(ListSize<Transform<std::add_pointer, BenchList>::Result>::value == TYPELIST_BENCH_SIZE);
+    static_assert(std::is_same_v<Filter<std::is_empty, BenchList>::Result, BenchList>);
+    static_assert(std::is_same_v<Concat<BenchList, EmptyList, IntList>::Result,
+                                 Append<int, BenchList>::Result>);
+
+}
@@ -0,0 +1,45 @@
+#!/bin/sh
+# Compiles compile_bench.cpp for several list sizes and prints the compiler's
+# own wall time and memory totals (from -ftime-report) for each size.
+#   ./compile_bench.sh [compiler] [sizes...]
+# Without a compiler argument it runs g++, and clang++ too when installed:
+# Clang rejects folds longer than its bracket depth, so long lists must be
+# checked there as well. Clang runs pin -fbracket-depth to its default of
+# 256 and report no memory total.
+cd "$(dirname "$0")" || exit 1
+
+if [ $# -gt 0 ]; then
+    COMPILERS=$1
+    shift
+elif [ -n "$CXX" ]; then
+    COMPILERS=$CXX
+else
+    COMPILERS=g++
+    command -v clang++ >/dev/null 2>&1 && COMPILERS="$COMPILERS clang++"
+fi
+SIZES=${*:-"50 100 200 300 500"}
+
+printf '%-10s  %8s  %10s  %10s\n' compiler size wall memory
+for cxx in $COMPILERS; do
+    flags=
+    "$cxx" --version 2>/dev/null | grep -qi clang && flags=-fbracket-depth=256
+    for size in $SIZES; do
+        report=$("$cxx" -std=c++20 -fsyntax-only -ftime-report $flags \
+            -DTYPELIST_BENCH_SIZE="$size" compile_bench.cpp 2>&1) || {
+            printf '%-10s  %8s  failed\n' "$cxx" "$size"
+            printf '%s\n' "$report" | head -n 5
+            continue
+        }
+        # GCC: " TOTAL : ... <wall> <memory>"; Clang's first report:
+        # "Total Execution Time: <cpu> seconds (<wall> wall clock)".
+        printf '%s\n' "$report" | awk -v cxx="$cxx" -v size="$size" '
+            /^ *TOTAL/ { printf "%-10s  %8s  %9ss  %10s\n", cxx, size, $(NF-1), $NF; exit }
+            /Total Execution Time:/ {
+                wall = $0
+                sub(/.*\(/, "", wall)
+                sub(/ wall clock\).*/, "", wall)
+                printf "%-10s  %8s  %9ss  %10s\n", cxx, size, wall, "-"
+                exit
+            }'
+    done
+done
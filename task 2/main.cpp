@@ -1,48 +1,72 @@
 #include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <array>
+#include <functional>
+
+#if defined(__has_builtin)
+#if __has_builtin(__type_pack_element)
+#define TYPELIST_HAS_TYPE_PACK_ELEMENT 1
+#endif
+#if __has_builtin(__is_same)
+#define TYPELIST_HAS_IS_SAME 1
+#endif
+#endif
+
+// The builtin compares types without instantiating std::is_same, which
+// matters for the quadratic scans in IndexOf and Unique.
+#ifdef TYPELIST_HAS_IS_SAME
+#define TYPELIST_IS_SAME(A, B) __is_same(A, B)
+#else
+#define TYPELIST_IS_SAME(A, B) std::is_same_v<A, B>
+#endif
 
 namespace TypeListUtilities {
 
     template <typename... Types>
     struct TypeList {};
 
+    // All lookups below are flat pack expansions, so instantiation depth
+    // stays constant no matter how long the list is.
     namespace details {
-        template <typename T, typename U>
-        struct IsTypeInList;
-
-        template <typename T, typename... Rest>
-        struct IsTypeInList<T, TypeList<T, Rest...>> : std::true_type {};
-
-        template <typename T, typename First, typename... Rest>
-        struct IsTypeInList<T, TypeList<First, Rest...>> : IsTypeInList<T, TypeList<Rest...>> {};
-
-        template <typename T>
-        struct IsTypeInList<T, TypeList<>> : std::false_type {};
-
-        template <typename T, typename U, std::size_t N>
-        struct TypeIndexHelper;
-
-        template <typename T, typename... Rest, std::size_t N>
-        struct TypeIndexHelper<T, TypeList<T, Rest...>, N> : std::integral_constant<std::size_t, N> {};
-
-        template <typename T, typename First, typename... Rest, std::size_t N>
-        struct TypeIndexHelper<T, TypeList<First, Rest...>, N> : TypeIndexHelper<T, TypeList<Rest...>, N+1> {};
-
-        template <typename T, std::size_t N>
-        struct TypeIndexHelper<T, TypeList<>, N>:std::integral_constant<int, -1> {};
+        template <typename T, typename... Types>
+        constexpr std::size_t index_of() {
+            constexpr bool matches[] = {TYPELIST_IS_SAME(T, Types)..., false};
+            for (std::size_t i = 0; i < sizeof...(Types); ++i) {
+                if (matches[i]) return i;
+            }
+            return sizeof...(Types);
+        }
+
+        template <std::size_t Index, typename T>
+        struct IndexedType {
+            using Type = T;
+        };
+
+        template <typename Indices, typename... Types>
+        struct IndexedTypes;
+
+        template <std::size_t... Indices, typename... Types>
+        struct IndexedTypes<std::index_sequence<Indices...>, Types...> : IndexedType<Indices, Types>... {};
+
+        // Overload resolution picks the single base with the requested index.
+        template <std::size_t Index, typename T>
+        IndexedType<Index, T> select_indexed(const IndexedType<Index, T>&);
     }
 
 
     template <std::size_t Index, typename List>
     struct TypeAt;
 
-    template <std::size_t Index, typename First, typename... Rest>
-    struct TypeAt<Index, TypeList<First, Rest...>> {
-        using Type = typename TypeAt<Index-1, TypeList<Rest...>>::Type;
-    };
-
-    template <typename First, typename... Rest>
-    struct TypeAt<0, TypeList<First, Rest...>> {
-        using Type = First;
+    template <std::size_t Index, typename... Types>
+    struct TypeAt<Index, TypeList<Types...>> {
+        static_assert(Index < sizeof...(Types), "TypeAt index out of range");
+#ifdef TYPELIST_HAS_TYPE_PACK_ELEMENT
+        using Type = __type_pack_element<Index, Types...>;
+#else
+        using Type = typename decltype(details::select_indexed<Index>(
+                details::IndexedTypes<std::index_sequence_for<Types...>, Types...>{}))::Type;
+#endif
     };
 
     template <typename List>
@@ -54,10 +78,23 @@ namespace TypeListUtilities {
 
 
     template <typename T, typename List>
-    struct Contains : details::IsTypeInList<T, List>::type {};
+    struct Contains;
 
+    // Not a fold: Clang caps a fold's operand count at its bracket depth
+    // (-fbracket-depth, 256 by default), so long lists would not compile.
+    template <typename T, typename... Types>
+    struct Contains<T, TypeList<Types...>>
+            : std::bool_constant<(details::index_of<T, Types...>() < sizeof...(Types))> {};
+
+    // Index of the first occurrence of T, or -1 (as int) when T is absent.
     template <typename T, typename List>
-    struct IndexOf : details::TypeIndexHelper<T, List, 0> {};
+    struct IndexOf;
+
+    template <typename T, typename... Types>
+    struct IndexOf<T, TypeList<Types...>>
+            : std::conditional_t<(details::index_of<T, Types...>() < sizeof...(Types)),
+                                 std::integral_constant<std::size_t, details::index_of<T, Types...>()>,
+                                 std::integral_constant<int, -1>> {};
 
     template <typename NewType, typename List>
     struct Prepend;
@@ -76,6 +113,199 @@ namespace TypeListUtilities {
         using Result = TypeList<Types..., NewType>;
     };
 
+
+    // Bulk transforms. Each one expands the whole list in a single step
+    // instead of chaining Prepend/Append per element, and none folds over
+    // the pack, since Clang limits a fold to its bracket depth.
+    namespace details {
+        template <typename List, typename Indices>
+        struct SelectIndices;
+
+        template <typename List, std::size_t... Indices>
+        struct SelectIndices<List, std::index_sequence<Indices...>> {
+            using Result = TypeList<typename TypeAt<Indices, List>::Type...>;
+        };
+
+        // Stable insertion sort of positions by key; lists are short enough
+        // that this beats anything fancier in constant evaluation.
+        template <typename Compare, typename Key, std::size_t N>
+        constexpr std::array<std::size_t, N> sorted_order(const std::array<Key, N>& keys) {
+            std::array<std::size_t, N> order{};
+            for (std::size_t i = 0; i < N; ++i) {
+                std::size_t j = i;
+                while (j > 0 && Compare{}(keys[i], keys[order[j - 1]])) {
+                    order[j] = order[j - 1];
+                    --j;
+                }
+                order[j] = i;
+            }
+            return order;
+        }
+
+        template <std::size_t N>
+        constexpr std::size_t count_flags(const std::array<bool, N>& flags) {
+            std::size_t count = 0;
+            for (bool flag : flags) count += flag;
+            return count;
+        }
+
+        // Positions of the set flags, in order.
+        template <auto Flags>
+        constexpr auto flagged_positions() {
+            std::array<std::size_t, count_flags(Flags)> result{};
+            std::size_t next = 0;
+            for (std::size_t i = 0; i < Flags.size(); ++i) {
+                if (Flags[i]) result[next++] = i;
+            }
+            return result;
+        }
+
+        template <typename... Types, std::size_t... Positions>
+        constexpr std::array<bool, sizeof...(Types)> first_occurrences(std::index_sequence<Positions...>) {
+            return {(index_of<Types, Types...>() == Positions)...};
+        }
+
+        template <typename List, auto Positions, typename Indices>
+        struct PickPositions;
+
+        template <typename List, auto Positions, std::size_t... Indices>
+        struct PickPositions<List, Positions, std::index_sequence<Indices...>> {
+            using Result = TypeList<typename TypeAt<Positions[Indices], List>::Type...>;
+        };
+
+        // Element index within list of the Concat output.
+        struct ListPosition {
+            std::size_t list;
+            std::size_t index;
+        };
+
+        template <std::size_t... Sizes>
+        constexpr std::size_t total_size() {
+            constexpr std::array<std::size_t, sizeof...(Sizes)> sizes{Sizes...};
+            std::size_t total = 0;
+            for (std::size_t size : sizes) total += size;
+            return total;
+        }
+
+        template <std::size_t Total, std::size_t... Sizes>
+        constexpr std::array<ListPosition, Total> concat_layout() {
+            constexpr std::array<std::size_t, sizeof...(Sizes)> sizes{Sizes...};
+            std::array<ListPosition, Total> result{};
+            std::size_t next = 0;
+            for (std::size_t list = 0; list < sizes.size(); ++list) {
+                for (std::size_t i = 0; i < sizes[list]; ++i) result[next++] = {list, i};
+            }
+            return result;
+        }
+
+        template <typename Lists, auto Positions, typename Indices>
+        struct PickNested;
+
+        template <typename Lists, auto Positions, std::size_t... Indices>
+        struct PickNested<Lists, Positions, std::index_sequence<Indices...>> {
+            using Result = TypeList<typename TypeAt<
+                    Positions[Indices].index, typename TypeAt<Positions[Indices].list, Lists>::Type>::Type...>;
+        };
+    }
+
+
+    // Every output element is looked up directly by (list, index), so the
+    // cost is linear in the total length rather than building a partial
+    // list per operand.
+    template <typename... Lists>
+    struct Concat {
+    private:
+        static constexpr auto layout =
+                details::concat_layout<details::total_size<ListSize<Lists>::value...>(),
+                                       ListSize<Lists>::value...>();
+
+    public:
+        using Result = typename details::PickNested<
+                TypeList<Lists...>, layout, std::make_index_sequence<layout.size()>>::Result;
+    };
+
+
+    template <template <typename> class Predicate, typename List>
+    struct Filter;
+
+    template <template <typename> class Predicate, typename... Types>
+    struct Filter<Predicate, TypeList<Types...>> {
+    private:
+        static constexpr auto positions = details::flagged_positions<
+                std::array<bool, sizeof...(Types)>{Predicate<Types>::value...}>();
+
+    public:
+        using Result = typename details::PickPositions<
+                TypeList<Types...>, positions, std::make_index_sequence<positions.size()>>::Result;
+    };
+
+
+    // Applies a standard-style trait (F<T>::type) to every element.
+    template <template <typename> class F, typename List>
+    struct Transform;
+
+    template <template <typename> class F, typename... Types>
+    struct Transform<F, TypeList<Types...>> {
+        using Result = TypeList<typename F<Types>::type...>;
+    };
+
+
+    template <typename List>
+    struct Reverse;
+
+    template <typename... Types>
+    struct Reverse<TypeList<Types...>> {
+    private:
+        static constexpr std::size_t size = sizeof...(Types);
+
+        template <std::size_t... Indices>
+        static auto reversed(std::index_sequence<Indices...>)
+                -> std::index_sequence<(size - 1 - Indices)...>;
+
+    public:
+        using Result = typename details::SelectIndices<
+                TypeList<Types...>, decltype(reversed(std::index_sequence_for<Types...>{}))>::Result;
+    };
+
+
+    // Keeps the first occurrence of every type, preserving order.
+    template <typename List>
+    struct Unique;
+
+    template <typename... Types>
+    struct Unique<TypeList<Types...>> {
+    private:
+        static constexpr auto positions = details::flagged_positions<
+                details::first_occurrences<Types...>(std::index_sequence_for<Types...>{})>();
+
+    public:
+        using Result = typename details::PickPositions<
+                TypeList<Types...>, positions, std::make_index_sequence<positions.size()>>::Result;
+    };
+
+
+    template <typename T>
+    struct SizeOf : std::integral_constant<std::size_t, sizeof(T)> {};
+
+    template <typename T>
+    struct AlignOf : std::integral_constant<std::size_t, alignof(T)> {};
+
+    // Stable sort by Key<T>::value. SortBy<AlignOf, List, std::greater<>>
+    // orders members so that a struct built from them has minimal padding.
+    template <template <typename> class Key, typename List, typename Compare = std::less<>>
+    struct SortBy;
+
+    template <template <typename> class Key, typename... Types, typename Compare>
+    struct SortBy<Key, TypeList<Types...>, Compare> {
+    private:
+        static constexpr std::array<std::size_t, sizeof...(Types)> order =
+                details::sorted_order<Compare>(std::array<std::size_t, sizeof...(Types)>{Key<Types>::value...});
+
+    public:
+        using Result = typename details::PickPositions<
+                TypeList<Types...>, order, std::index_sequence_for<Types...>>::Result;
+    };
+
 }
 
 using namespace TypeListUtilities;
@@ -92,6 +322,7 @@ static_assert(!Contains<long, TestList>::value);
 
 static_assert(IndexOf<double, TestList>::value == 1);
 static_assert(IndexOf<float, TestList>::value == 3);
+static_assert(IndexOf<long, TestList>::value == -1);
 
 using PrependedList = Prepend<bool, TestList>::Result;
 static_assert(std::is_same_v<TypeAt<0, PrependedList>::Type, bool>);
@@ -102,6 +333,31 @@ static_assert(std::is_same_v<TypeAt<4, AppendedList>::Type, long>);
 
 static_assert(std::is_same_v<TypeAt<2, TestList>::Type, int>);
 
+static_assert(std::is_same_v<Concat<>::Result, EmptyList>);
+static_assert(std::is_same_v<Concat<IntList, TestList, EmptyList>::Result,
+                             TypeList<int, char, double, int, float>>);
+
+static_assert(std::is_same_v<Filter<std::is_integral, TestList>::Result, TypeList<char, int>>);
+static_assert(std::is_same_v<Filter<std::is_integral, EmptyList>::Result, EmptyList>);
+
+static_assert(std::is_same_v<Transform<std::add_pointer, TestList>::Result,
+                             TypeList<char*, double*, int*, float*>>);
+
+static_assert(std::is_same_v<Reverse<TestList>::Result, TypeList<float, int, double, char>>);
+static_assert(std::is_same_v<Reverse<EmptyList>::Result, EmptyList>);
+
+static_assert(std::is_same_v<Unique<TypeList<int, char, int, double, char>>::Result,
+                             TypeList<int, char, double>>);
+static_assert(std::is_same_v<Unique<EmptyList>::Result, EmptyList>);
+
+static_assert(std::is_same_v<SortBy<SizeOf, TestList>::Result, TypeList<char, int, float, double>>);
+static_assert(std::is_same_v<SortBy<AlignOf, TypeList<char, double, short, long long>, std::greater<>>::Result,
+                             TypeList<double, long long, short, char>>);
+
+// Other tasks include this file for the TypeList utilities and define
+// TYPELIST_NO_MAIN to supply their own main().
+#ifndef TYPELIST_NO_MAIN
 int main() {
     return 0;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
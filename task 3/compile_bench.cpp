@@ -0,0 +1,52 @@
+// Compile-time benchmark for BasicTypeMap. Instantiates TypeMap and
+// PackedTypeMap over TYPEMAP_BENCH_SIZE distinct types (at most 64, the
+// PackedStorage limit) and touches every member function per type. Only
+// meant to be compiled, not linked:
+//   g++ -std=c++20 -fsyntax-only -ftime-report -DTYPEMAP_BENCH_SIZE=32 compile_bench.cpp
+// compile_bench.sh runs it over a range of sizes.
+#include <utility>
+
+#define TYPEMAP_NO_MAIN
+#include "main.cpp"
+
+#ifndef TYPEMAP_BENCH_SIZE
+#define TYPEMAP_BENCH_SIZE 32
+#endif
+
+namespace CompileBench {
+
+    template <int I>
+    struct BenchType {
+        int value = I;
+    };
+
+    template <template <typename...> class Map, typename Sequence>
+    struct MakeBenchMap;
+
+    template <template <typename...> class Map, int... Is>
+    struct MakeBenchMap<Map, std::integer_sequence<int, Is...>> {
+        using Result = Map<BenchType<Is>...>;
+    };
+
+    template <typename Map, int... Is>
+    int touch_all(Map& map, std::integer_sequence<int, Is...>) {
+        (map.AddValue(BenchType<Is>{}), ...);
+        int sum = (map.template GetValue<BenchType<Is>>().value + ...);
+        sum += (static_cast<int>(map.template Contains<BenchType<Is>>()) + ...);
+        (map.template RemoveValue<BenchType<Is>>(), ...);
+        map.for_each_present([&](const auto& value) { sum += value.value; });
+        for (std::size_t i = 0; i < Map::size(); ++i) sum += map.contains_by_index(i);
+        return sum;
+    }
+
+    using Sizes = std::make_integer_sequence<int, TYPEMAP_BENCH_SIZE>;
+    using OptionalBenchMap = MakeBenchMap<TypeMap, Sizes>::Result;
+    using PackedBenchMap = MakeBenchMap<PackedTypeMap, Sizes>::Result;
+
+    inline int run() {
+        OptionalBenchMap optional_map;
+        PackedBenchMap packed_map;
+        return touch_all(optional_map, Sizes{}) + touch_all(packed_map, Sizes{});
+    }
+
+}
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Compiles compile_bench.cpp for several map sizes and prints the compiler's
+# own wall time and GC memory totals (from -ftime-report) for each size.
+#   ./compile_bench.sh [compiler] [sizes...]
+cd "$(dirname "$0")" || exit 1
+
+CXX=${1:-${CXX:-g++}}
+[ $# -gt 0 ] && shift
+SIZES=${*:-"8 16 32 48 64"}
+
+printf '%8s  %10s  %10s\n' size wall memory
+for size in $SIZES; do
+    report=$("$CXX" -std=c++20 -fsyntax-only -ftime-report \
+        -DTYPEMAP_BENCH_SIZE="$size" compile_bench.cpp 2>&1) || {
+        printf '%8s  failed\n' "$size"
+        printf '%s\n' "$report" | head -n 5
+        continue
+    }
+    printf '%s\n' "$report" | awk -v size="$size" \
+        '/^ *TOTAL/ { printf "%8s  %9ss  %10s\n", size, $(NF-1), $NF }'
+done
@@ -2,46 +2,440 @@
 #include <optional>
 #include <stdexcept>
 #include <type_traits>
+#include <tuple>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <string>
+#include <utility>
+#include <bit>
+#define TYPELIST_NO_MAIN
 #include "../task 2/main.cpp"
 
 
-template <typename... Types>
-class TypeMap {
-    using StorageType = std::tuple<std::optional<Types>...>;
+namespace TypeMapDetails {
+    // Bit i is set when the i-th type of the map holds a value.
+    template <std::size_t Count>
+    using PresenceMask = std::conditional_t<Count <= 8, std::uint8_t,
+                         std::conditional_t<Count <= 16, std::uint16_t,
+                         std::conditional_t<Count <= 32, std::uint32_t, std::uint64_t>>>;
+
+    template <typename T, typename... Types>
+    constexpr PresenceMask<sizeof...(Types)> type_bit =
+            PresenceMask<sizeof...(Types)>{1} << TypeListUtilities::IndexOf<T, TypeListUtilities::TypeList<Types...>>::value;
+}
+
+// Storage policies for BasicTypeMap. A policy provides Storage<Types...> with
+// contains/get/assign/reset per type, unchecked value<T>() access for types
+// known to be present, plus present_mask() and clear().
+
+// One std::optional per type: simple, but every member carries its own flag
+// and padding.
+struct OptionalStorage {
+    template <typename... Types>
+    class Storage {
+        std::tuple<std::optional<Types>...> values_;
+
+    public:
+        using Mask = TypeMapDetails::PresenceMask<sizeof...(Types)>;
+
+        Mask present_mask() const {
+            return static_cast<Mask>(
+                    (Mask{0} | ... | (contains<Types>() ? TypeMapDetails::type_bit<Types, Types...> : Mask{0})));
+        }
+
+        void clear() { (reset<Types>(), ...); }
+
+        template <typename T>
+        bool contains() const {
+            return std::get<std::optional<T>>(values_).has_value();
+        }
+
+        template <typename T>
+        const T* get() const {
+            const auto& opt = std::get<std::optional<T>>(values_);
+            return opt ? &*opt : nullptr;
+        }
+
+        template <typename T>
+        T& value() { return *std::get<std::optional<T>>(values_); }
+
+        template <typename T>
+        const T& value() const { return *std::get<std::optional<T>>(values_); }
+
+        template <typename T, typename U>
+        void assign(U&& value) {
+            std::get<std::optional<T>>(values_) = std::forward<U>(value);
+        }
+
+        template <typename T>
+        void reset() {
+            std::get<std::optional<T>>(values_).reset();
+        }
+    };
+};
+
+
+namespace TypeMapDetails {
+    constexpr std::size_t align_up(std::size_t offset, std::size_t alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    template <std::size_t Count>
+    struct PackedLayout {
+        std::array<std::size_t, Count> offsets{};
+        std::size_t mask_offset = 0;
+        std::size_t hot_end = 0;
+        std::size_t size = 0;
+        std::size_t alignment = 1;
+    };
+
+    // Places the members of Layout in order. The presence mask goes right
+    // after the first HotCount members so it shares their cache line, or at
+    // the tail (where alignment is smallest) when there are no hot members.
+    template <typename Mask, std::size_t HotCount, typename Layout>
+    struct ComputeLayout;
+
+    template <typename Mask, std::size_t HotCount, typename... Layout>
+    struct ComputeLayout<Mask, HotCount, TypeListUtilities::TypeList<Layout...>> {
+        static constexpr PackedLayout<sizeof...(Layout)> value = [] {
+            constexpr std::size_t sizes[] = {sizeof(Layout)..., 0};
+            constexpr std::size_t alignments[] = {alignof(Layout)..., 1};
+            PackedLayout<sizeof...(Layout)> layout;
+            std::size_t offset = 0;
+            auto place_mask = [&] {
+                offset = align_up(offset, alignof(Mask));
+                layout.mask_offset = offset;
+                offset += sizeof(Mask);
+            };
+            for (std::size_t i = 0; i < sizeof...(Layout); ++i) {
+                if (i == HotCount && HotCount != 0) place_mask();
+                offset = align_up(offset, alignments[i]);
+                layout.offsets[i] = offset;
+                offset += sizes[i];
+                if (alignments[i] > layout.alignment) layout.alignment = alignments[i];
+            }
+            if (HotCount == 0 || HotCount == sizeof...(Layout)) place_mask();
+            layout.hot_end = HotCount == 0 ? 0 : layout.mask_offset + sizeof(Mask);
+            if (alignof(Mask) > layout.alignment) layout.alignment = alignof(Mask);
+            layout.size = align_up(offset, layout.alignment);
+            return layout;
+        }();
+    };
+}
+
+
+// Members live in one raw buffer, ordered by descending alignment so that
+// padding is minimal, and a single bitmask records which are present. Types
+// listed in HotTypes are placed first, together with the mask, and must fit
+// in the first cache line; with any hot types the buffer is cache-line
+// aligned so that line really is a single one.
+template <typename HotTypes = TypeListUtilities::TypeList<>>
+struct PackedStorage {
+    template <typename... Types>
+    class Storage {
+        using AllTypes = TypeListUtilities::TypeList<Types...>;
+
+        static_assert(std::is_same_v<typename TypeListUtilities::Unique<AllTypes>::Result, AllTypes>,
+                      "TypeMap types must be distinct");
+        static_assert(sizeof...(Types) <= 64, "PackedStorage supports at most 64 types");
+
+        template <typename T>
+        struct IsHot : TypeListUtilities::Contains<T, HotTypes> {};
+
+        template <typename T>
+        struct IsCold : std::bool_constant<!IsHot<T>::value> {};
+
+        using Hot = typename TypeListUtilities::SortBy<TypeListUtilities::AlignOf,
+                typename TypeListUtilities::Filter<IsHot, AllTypes>::Result, std::greater<>>::Result;
+        using Cold = typename TypeListUtilities::SortBy<TypeListUtilities::AlignOf,
+                typename TypeListUtilities::Filter<IsCold, AllTypes>::Result, std::greater<>>::Result;
+        using Layout = typename TypeListUtilities::Concat<Hot, Cold>::Result;
+
+    public:
+        using Mask = TypeMapDetails::PresenceMask<sizeof...(Types)>;
+
+    private:
+        static constexpr auto layout =
+                TypeMapDetails::ComputeLayout<Mask, TypeListUtilities::ListSize<Hot>::value, Layout>::value;
+
+        static constexpr std::size_t cache_line = 64;
+        static_assert(layout.hot_end <= cache_line, "Hot types do not fit in one cache line");
+
+        static constexpr std::size_t storage_alignment =
+                TypeListUtilities::ListSize<Hot>::value > 0 && layout.alignment < cache_line ? cache_line
+                                                                                             : layout.alignment;
+
+        template <typename T>
+        static constexpr Mask bit = TypeMapDetails::type_bit<T, Types...>;
+
+        template <typename T>
+        static constexpr std::size_t offset = layout.offsets[TypeListUtilities::IndexOf<T, Layout>::value];
+
+        alignas(storage_alignment) std::byte bytes_[layout.size];
+
+        Mask& mask() { return *std::launder(reinterpret_cast<Mask*>(bytes_ + layout.mask_offset)); }
+        const Mask& mask() const { return *std::launder(reinterpret_cast<const Mask*>(bytes_ + layout.mask_offset)); }
+
+        template <typename T>
+        T* slot() { return std::launder(reinterpret_cast<T*>(bytes_ + offset<T>)); }
+
+        template <typename T>
+        const T* slot() const { return std::launder(reinterpret_cast<const T*>(bytes_ + offset<T>)); }
+
+        template <typename T>
+        void destroy_if_present(Mask present) {
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                if (present & bit<T>) slot<T>()->~T();
+            }
+        }
+
+        template <typename T, typename Source>
+        void copy_from(Source&& other) {
+            if (other.template contains<T>()) {
+                if constexpr (std::is_rvalue_reference_v<Source&&>) {
+                    assign<T>(std::move(*other.template slot<T>()));
+                } else {
+                    assign<T>(*other.template slot<T>());
+                }
+            } else {
+                reset<T>();
+            }
+        }
+
+    public:
+        Storage() { ::new (bytes_ + layout.mask_offset) Mask{0}; }
+
+        Storage(const Storage& other) : Storage() { (copy_from<Types>(other), ...); }
+
+        Storage(Storage&& other) noexcept((std::is_nothrow_move_constructible_v<Types> && ...)) : Storage() {
+            (copy_from<Types>(std::move(other)), ...);
+        }
+
+        Storage& operator=(const Storage& other) {
+            if (this != &other) (copy_from<Types>(other), ...);
+            return *this;
+        }
+
+        Storage& operator=(Storage&& other) {
+            if (this != &other) (copy_from<Types>(std::move(other)), ...);
+            return *this;
+        }
+
+        ~Storage() { (reset<Types>(), ...); }
+
+        Mask present_mask() const { return mask(); }
+
+        // One inlined bit test and destructor call per member that needs
+        // one; for trivially destructible members this is a single store.
+        void clear() {
+            Mask present = mask();
+            (destroy_if_present<Types>(present), ...);
+            mask() = 0;
+        }
+
+        static constexpr std::size_t padding_bytes() {
+            return layout.size - (sizeof(Types) + ... + sizeof(Mask));
+        }
+
+        template <typename T>
+        bool contains() const {
+            return (mask() & bit<T>) != 0;
+        }
+
+        template <typename T>
+        const T* get() const {
+            return contains<T>() ? slot<T>() : nullptr;
+        }
+
+        template <typename T>
+        T& value() { return *slot<T>(); }
+
+        template <typename T>
+        const T& value() const { return *slot<T>(); }
+
+        template <typename T, typename U>
+        void assign(U&& value) {
+            if (contains<T>()) {
+                *slot<T>() = std::forward<U>(value);
+            } else {
+                ::new (bytes_ + offset<T>) T(std::forward<U>(value));
+                mask() |= bit<T>;
+            }
+        }
+
+        template <typename T>
+        void reset() {
+            if (contains<T>()) {
+                slot<T>()->~T();
+                mask() &= static_cast<Mask>(~bit<T>);
+            }
+        }
+    };
+};
+
+
+template <typename StoragePolicy, typename... Types>
+class BasicTypeMap {
+    using StorageType = typename StoragePolicy::template Storage<Types...>;
     StorageType storage;
 
+    template <typename T>
+    static constexpr bool allowed = TypeListUtilities::Contains<T, TypeListUtilities::TypeList<Types...>>::value;
+
+    // Calls visit(std::type_identity<T>{}) for every T whose bit is set in
+    // bits, in declaration order. Expands to one bit test and direct call
+    // per type, so the visitor is inlined; function tables are kept for the
+    // *_by_index API, where the type really is only known at run time.
+    template <typename Mask, typename Visit>
+    static void for_each_bit(Mask bits, Visit&& visit) {
+        ((bits & TypeMapDetails::type_bit<Types, Types...> ? visit(std::type_identity<Types>{}) : void()), ...);
+    }
+
+    void check_index(std::size_t index) const {
+        if (index >= sizeof...(Types)) throw std::out_of_range("TypeMap index out of range");
+    }
+
 public:
+    using Mask = typename StorageType::Mask;
+
+    // Runtime type tags are positions in Types...; type_index<T>() maps a
+    // static type to its tag.
+    template <typename T>
+    static constexpr std::size_t type_index() {
+        static_assert(allowed<T>, "Type not allowed in this TypeMap");
+        return TypeListUtilities::IndexOf<T, TypeListUtilities::TypeList<Types...>>::value;
+    }
+
+    static constexpr std::size_t size() {
+        return sizeof...(Types);
+    }
     template <typename T>
     void AddValue(T&& value) {
-        static_assert(TypeListUtilities::Contains<T, TypeListUtilities::TypeList<Types...>>::value,
-                      "Type not allowed in this TypeMap");
-        std::get<std::optional<T>>(storage) = std::forward<T>(value);
+        using Value = std::remove_cvref_t<T>;
+        static_assert(allowed<Value>, "Type not allowed in this TypeMap");
+        storage.template assign<Value>(std::forward<T>(value));
     }
 
     template <typename T>
-    decltype(auto) GetValue() const {
-        static_assert(TypeListUtilities::Contains<T, TypeListUtilities::TypeList<Types...>>::value,
-                      "Type not allowed in this TypeMap");
-        const auto& opt = std::get<std::optional<T>>(storage);
-        if (!opt) throw std::runtime_error("Value not found");
-        return *opt;
+    const T& GetValue() const {
+        static_assert(allowed<T>, "Type not allowed in this TypeMap");
+        // contains() then value() rather than get(): a pointer result would
+        // need a null test the compiler cannot drop.
+        if (!storage.template contains<T>()) throw std::runtime_error("Value not found");
+        return storage.template value<T>();
     }
 
     template <typename T>
     bool Contains() const {
-        return std::get<std::optional<T>>(storage).has_value();
+        return storage.template contains<T>();
     }
 
     template <typename T>
     void RemoveValue() {
-        std::get<std::optional<T>>(storage).reset();
+        storage.template reset<T>();
+    }
+
+    Mask present_mask() const {
+        return storage.present_mask();
+    }
+
+    // Invokes visitor(value) for every stored value in declaration order.
+    template <typename Visitor>
+    void for_each_present(Visitor&& visitor) {
+        for_each_bit(storage.present_mask(), [&]<typename T>(std::type_identity<T>) {
+            visitor(storage.template value<T>());
+        });
+    }
+
+    template <typename Visitor>
+    void for_each_present(Visitor&& visitor) const {
+        for_each_bit(storage.present_mask(), [&]<typename T>(std::type_identity<T>) {
+            visitor(storage.template value<T>());
+        });
+    }
+
+    bool contains_by_index(std::size_t index) const {
+        check_index(index);
+        return (present_mask() >> index) & 1u;
+    }
+
+    // Address of the value stored under a runtime tag, or nullptr when that
+    // slot is empty.
+    const void* get_by_index(std::size_t index) const {
+        check_index(index);
+        if constexpr (sizeof...(Types) != 0) {
+            using Accessor = const void* (*)(const StorageType&);
+            static constexpr Accessor accessors[] = {
+                    [](const StorageType& s) -> const void* { return s.template get<Types>(); }...};
+            return accessors[index](storage);
+        }
+        return nullptr;
+    }
+
+    void* get_by_index(std::size_t index) {
+        return const_cast<void*>(std::as_const(*this).get_by_index(index));
+    }
+
+    // Calls visitor with the typed value under a runtime tag. Returns false
+    // without calling it when the slot is empty.
+    template <typename Visitor>
+    bool visit_by_index(std::size_t index, Visitor&& visitor) {
+        if (!contains_by_index(index)) return false;
+        if constexpr (sizeof...(Types) != 0) {
+            using Handler = void (*)(StorageType&, Visitor&);
+            static constexpr Handler handlers[] = {
+                    [](StorageType& s, Visitor& v) { v(s.template value<Types>()); }...};
+            handlers[index](storage, visitor);
+        }
+        return true;
+    }
+
+    template <typename Visitor>
+    bool visit_by_index(std::size_t index, Visitor&& visitor) const {
+        if (!contains_by_index(index)) return false;
+        if constexpr (sizeof...(Types) != 0) {
+            using Handler = void (*)(const StorageType&, Visitor&);
+            static constexpr Handler handlers[] = {
+                    [](const StorageType& s, Visitor& v) { v(s.template value<Types>()); }...};
+            handlers[index](storage, visitor);
+        }
+        return true;
+    }
+
+    void clear() {
+        storage.clear();
+    }
+
+    // Like std::map::merge: moves every value whose type is absent here out
+    // of other; values for types both maps hold stay in other.
+    void merge(BasicTypeMap& other) {
+        auto transfer = static_cast<Mask>(other.present_mask() & ~present_mask());
+        for_each_bit(transfer, [&]<typename T>(std::type_identity<T>) {
+            storage.template assign<T>(std::move(other.storage.template value<T>()));
+            other.storage.template reset<T>();
+        });
+    }
+
+    void merge(BasicTypeMap&& other) {
+        merge(other);
     }
 };
 
+template <typename... Types>
+using TypeMap = BasicTypeMap<OptionalStorage, Types...>;
+
+template <typename... Types>
+using PackedTypeMap = BasicTypeMap<PackedStorage<>, Types...>;
+
 
 struct DataA { std::string value; };
 struct DataB { int value; };
 
+// The benchmark suite includes this file and defines TYPEMAP_NO_MAIN.
+#ifndef TYPEMAP_NO_MAIN
 int main() {
     TypeMap<int, DataA, double, DataB> myTypeMap;
 
@@ -53,4 +447,44 @@ int main() {
     std::cout << "DataA: " << myTypeMap.GetValue<DataA>().value << std::endl;
     myTypeMap.RemoveValue<double>();
     std::cout << "Contains double: " << myTypeMap.Contains<double>() << std::endl;
+
+    BasicTypeMap<PackedStorage<TypeListUtilities::TypeList<DataB>>, int, DataA, double, DataB> packedMap;
+    packedMap.AddValue(DataA{"Packed"});
+    packedMap.AddValue(DataB{7});
+    auto copy = packedMap;
+    packedMap.RemoveValue<DataA>();
+    std::cout << "Packed DataA copy: " << copy.GetValue<DataA>().value
+              << ", DataB: " << copy.GetValue<DataB>().value << std::endl;
+
+    decltype(packedMap) other;
+    other.AddValue(2.5);
+    other.AddValue(DataB{99});
+    packedMap.merge(other);
+    std::cout << "Merged:";
+    packedMap.for_each_present([](const auto& value) {
+        using Value = std::remove_cvref_t<decltype(value)>;
+        if constexpr (std::is_same_v<Value, DataA> || std::is_same_v<Value, DataB>) {
+            std::cout << ' ' << value.value;
+        } else {
+            std::cout << ' ' << value;
+        }
+    });
+    std::cout << " (left in source: " << +other.present_mask() << ")" << std::endl;
+    packedMap.clear();
+    std::cout << "After clear: " << +packedMap.present_mask() << std::endl;
+
+    std::size_t tag = myTypeMap.type_index<DataA>();
+    std::cout << "Tag " << tag << " present: " << myTypeMap.contains_by_index(tag) << ", value: "
+              << static_cast<const DataA*>(myTypeMap.get_by_index(tag))->value << std::endl;
+    myTypeMap.visit_by_index(myTypeMap.type_index<int>(), [](auto& value) {
+        if constexpr (std::is_same_v<std::remove_cvref_t<decltype(value)>, int>) value *= 2;
+    });
+    std::cout << "Doubled int: " << myTypeMap.GetValue<int>() << std::endl;
+
+    std::cout << "sizeof optional storage: "
+              << sizeof(OptionalStorage::Storage<char, double, short, int, bool, float, std::uint16_t, long long>)
+              << ", packed storage: "
+              << sizeof(PackedStorage<>::Storage<char, double, short, int, bool, float, std::uint16_t, long long>)
+              << std::endl;
 }
+#endif
@@ -1,5 +1,26 @@
 #include <iostream>
 #include <cassert>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <compare>
+#include <concepts>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+// Instance counting is on in every build type. Define COUNTER_DISABLE to
+// compile it out, leaving count() and created() at zero.
+#ifdef COUNTER_DISABLE
+#define COUNTER_ENABLED 0
+#else
+#define COUNTER_ENABLED 1
+#endif
 
 template <typename Derived>
 class less_than_comparable {
@@ -26,21 +47,166 @@ public:
 };
 
 
+// Derived defines a single operator<=>. <, >, <= and >= are rewritten by the
+// language in terms of it, and == / != fall back to one <=> call instead of
+// two operator< calls. If Derived declares its own (cheaper) operator==, that
+// non-template overload is preferred over the fallback here.
+template <typename Derived>
+class three_way_comparable {
+public:
+    template <std::same_as<Derived> D>
+    friend bool operator==(const D& lhs, const D& rhs) {
+        return (lhs <=> rhs) == 0;
+    }
+};
+
+
+// Counts instances of T. Every thread bumps its own cache-line-sized shard
+// (single writer, so plain relaxed stores, no contended RMW); count() and
+// created() sum the shards on demand. Objects may die on another thread than
+// the one that created them, so only the totals are meaningful.
 template <typename T>
 class counter {
 protected:
-    counter() { count_++; }
-    counter(const counter&) { count_++; }
-    counter(counter&&)  noexcept { count_++; }
-    ~counter() { count_++; }
+    counter() { on_create(); }
+    counter(const counter&) { on_create(); }
+    counter(counter&&) noexcept { on_create(); }
+    ~counter() { on_destroy(); }
 
 public:
+    // Instances currently alive. Shards are read while other threads keep
+    // counting, so a destruction can be seen without its creation; the
+    // difference is clamped at zero.
     static size_t count() {
-        return count_;
+        Totals totals = collect();
+        return totals.created > totals.destroyed ? totals.created - totals.destroyed : 0;
+    }
+
+    // Instances ever constructed, including copies and moves.
+    static size_t created() {
+        return collect().created;
     }
 
 private:
-    inline static size_t count_ = 0;
+    struct Totals {
+        size_t created = 0;
+        size_t destroyed = 0;
+    };
+
+    struct alignas(64) Shard {
+        std::atomic<size_t> created{0};
+        std::atomic<size_t> destroyed{0};
+    };
+
+    // Leaked on purpose so that it outlives every counted object, including
+    // ones with static storage destroyed during program teardown.
+    struct Registry {
+        std::mutex mutex;
+        std::vector<Shard*> shards;
+        Totals retired;
+    };
+
+    static Registry& registry() {
+        static Registry* instance = new Registry;
+        return *instance;
+    }
+
+    // The calling thread's shard. Constant-initialized and trivially
+    // destructible, so it stays readable during thread and program
+    // teardown, when a thread_local Shard object might already be gone.
+    struct LocalState {
+        Shard* shard = nullptr;
+        bool exited = false;
+    };
+
+    static LocalState& local_state() {
+        constinit thread_local LocalState state;
+        return state;
+    }
+
+    // Owns the shard for the thread's lifetime; on thread exit folds its
+    // counts into the retired totals and marks the thread as exited.
+    struct ShardOwner {
+        Shard* shard = new Shard;
+
+        ShardOwner() {
+            Registry& reg = registry();
+            std::lock_guard lock(reg.mutex);
+            reg.shards.push_back(shard);
+        }
+
+        ~ShardOwner() {
+            Registry& reg = registry();
+            {
+                std::lock_guard lock(reg.mutex);
+                reg.retired.created += shard->created.load(std::memory_order_relaxed);
+                reg.retired.destroyed += shard->destroyed.load(std::memory_order_relaxed);
+                std::erase(reg.shards, shard);
+            }
+            delete shard;
+            local_state() = {nullptr, true};
+        }
+    };
+
+    // nullptr once the thread's shard is gone (objects destroyed after its
+    // thread_locals, e.g. statics on the main thread).
+    static Shard* local_shard() {
+        LocalState& state = local_state();
+        if (!state.shard && !state.exited) {
+            thread_local ShardOwner owner;
+            state.shard = owner.shard;
+        }
+        return state.shard;
+    }
+
+    // Slow path for a thread whose shard has been retired.
+    static void count_retired(size_t Totals::*field) {
+        Registry& reg = registry();
+        std::lock_guard lock(reg.mutex);
+        ++(reg.retired.*field);
+    }
+
+    static void bump(std::atomic<size_t>& value) {
+        value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static void on_create() {
+        if constexpr (COUNTER_ENABLED) {
+            if (Shard* shard = local_shard()) {
+                bump(shard->created);
+            } else {
+                count_retired(&Totals::created);
+            }
+        }
+    }
+
+    static void on_destroy() {
+        if constexpr (COUNTER_ENABLED) {
+            if (Shard* shard = local_shard()) {
+                bump(shard->destroyed);
+            } else {
+                count_retired(&Totals::destroyed);
+            }
+        }
+    }
+
+    static Totals collect() {
+        Totals totals;
+        if constexpr (COUNTER_ENABLED) {
+            Registry& reg = registry();
+            std::lock_guard lock(reg.mutex);
+            totals = reg.retired;
+            // Destructions first, so one that races with the reads is less
+            // likely to be counted without its creation.
+            for (const Shard* shard : reg.shards) {
+                totals.destroyed += shard->destroyed.load(std::memory_order_relaxed);
+            }
+            for (const Shard* shard : reg.shards) {
+                totals.created += shard->created.load(std::memory_order_relaxed);
+            }
+        }
+        return totals;
+    }
 };
 
 class Number : public less_than_comparable<Number>,
@@ -61,7 +227,90 @@ private:
     int m_value;
 };
 
-int main() {
+// Composite keys for the comparison benchmark: identical data, one ordered
+// through less_than_comparable, one through three_way_comparable.
+struct LegacyKey : less_than_comparable<LegacyKey> {
+    int group;
+    std::string name;
+
+    LegacyKey(int g, std::string n) : group{g}, name{std::move(n)} {}
+
+    bool operator<(const LegacyKey& other) const {
+        if (group != other.group) return group < other.group;
+        return name < other.name;
+    }
+};
+
+struct ThreeWayKey : three_way_comparable<ThreeWayKey> {
+    int group;
+    std::string name;
+
+    ThreeWayKey(int g, std::string n) : group{g}, name{std::move(n)} {}
+
+    std::strong_ordering operator<=>(const ThreeWayKey& other) const {
+        if (auto cmp = group <=> other.group; cmp != 0) return cmp;
+        return name.compare(other.name) <=> 0;
+    }
+
+    // Cheaper than <=>: different lengths settle it without a byte compare.
+    bool operator==(const ThreeWayKey& other) const {
+        return group == other.group && name == other.name;
+    }
+};
+
+struct SortUniqueTiming {
+    double sort_ms = 0;
+    double unique_ms = 0;
+    size_t unique_count = 0;
+};
+
+template <typename Key>
+SortUniqueTiming bench_sort_unique(const std::vector<std::pair<int, std::string>>& data) {
+    std::vector<Key> keys;
+    keys.reserve(data.size());
+    for (const auto& [group, name] : data) keys.emplace_back(group, name);
+
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    std::sort(keys.begin(), keys.end());
+    auto sorted = Clock::now();
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    auto done = Clock::now();
+
+    return {std::chrono::duration<double, std::milli>(sorted - start).count(),
+            std::chrono::duration<double, std::milli>(done - sorted).count(),
+            keys.size()};
+}
+
+void run_compare_benchmark(size_t count) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> groups(0, 3);
+    std::uniform_int_distribution<int> suffixes(0, static_cast<int>(count / 16));
+    std::vector<std::pair<int, std::string>> data;
+    data.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        data.emplace_back(groups(rng), "checkpoint/segment/" + std::to_string(suffixes(rng)));
+    }
+
+    auto report = [](const char* name, const SortUniqueTiming& timing) {
+        std::cout << "  " << name << ": sort " << timing.sort_ms << " ms, unique " << timing.unique_ms
+                  << " ms" << std::endl;
+    };
+
+    SortUniqueTiming legacy = bench_sort_unique<LegacyKey>(data);
+    SortUniqueTiming three_way = bench_sort_unique<ThreeWayKey>(data);
+    std::cout << "sort+unique over " << count << " keys (" << legacy.unique_count << " unique)" << std::endl;
+    report("less_than_comparable", legacy);
+    report("three_way_comparable", three_way);
+    assert(legacy.unique_count == three_way.unique_count);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::strcmp(argv[1], "--bench-compare") == 0) {
+        run_compare_benchmark(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2'000'000);
+        return 0;
+    }
+
     Number one{1};
     Number two{2};
     Number three{3};
@@ -76,11 +325,33 @@ int main() {
 
     std::cout << "Count: " << counter<Number>::count() << std::endl;
 
+    {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 8; ++t) {
+            workers.emplace_back([t] {
+                std::vector<Number> local;
+                for (int i = 0; i < 1000; ++i) local.emplace_back(t * 1000 + i);
+            });
+        }
+        for (auto& worker : workers) worker.join();
+    }
+
+    std::cout << "Count after threads: " << counter<Number>::count()
+              << ", created: " << counter<Number>::created() << std::endl;
+#if COUNTER_ENABLED
+    assert(counter<Number>::count() == 4);
+#endif
+
     assert(one >= one);
     assert(three <= four);
     assert(two == two);
     assert(three > two);
     assert(one < two);
 
+    ThreeWayKey a{1, "a"};
+    ThreeWayKey b{1, "b"};
+    assert(a < b && b > a && a <= a && b >= a);
+    assert(a == a && a != b);
+
     return 0;
 }
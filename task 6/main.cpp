@@ -4,6 +4,62 @@
 #include <algorithm>
 #include <memory>
 #include <stdexcept>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string_view>
+#include <charconv>
+#include <fstream>
+#include <istream>
+#include <cmath>
+#include <limits>
+#include <span>
+
+namespace Geo {
+    constexpr double kEarthRadiusKm = 6371.0088;
+    constexpr double kDegToRad = 3.14159265358979323846 / 180.0;
+
+    inline double haversine_km(double lat1, double lon1, double lat2, double lon2) {
+        double dlat = (lat2 - lat1) * kDegToRad;
+        double dlon = (lon2 - lon1) * kDegToRad;
+        double a = std::sin(dlat / 2) * std::sin(dlat / 2) +
+                   std::cos(lat1 * kDegToRad) * std::cos(lat2 * kDegToRad) * std::sin(dlon / 2) * std::sin(dlon / 2);
+        return 2 * kEarthRadiusKm * std::asin(std::min(1.0, std::sqrt(a)));
+    }
+
+    // Points on the unit sphere. The straight-line (chord) distance between
+    // two of them is monotonic in the great-circle distance, so nearest
+    // searches can compare chords with plain arithmetic and convert only
+    // the winner.
+    struct UnitVector {
+        double x, y, z;
+    };
+
+    inline UnitVector to_unit(double lat, double lon) {
+        double phi = lat * kDegToRad;
+        double lambda = lon * kDegToRad;
+        return {std::cos(phi) * std::cos(lambda), std::cos(phi) * std::sin(lambda), std::sin(phi)};
+    }
+
+    // Same value as haversine_km for the two points the chord joins.
+    inline double chord_squared_to_km(double chord_squared) {
+        return 2 * kEarthRadiusKm * std::asin(std::min(1.0, std::sqrt(chord_squared) / 2));
+    }
+
+    // out[i] = squared chord from (qx, qy, qz) to point i. Branch-free over
+    // contiguous columns, so it compiles to packed SIMD arithmetic.
+    inline void chord_squared_batch(const double* xs, const double* ys, const double* zs, size_t count,
+                                    const UnitVector& q, double* out) {
+        for (size_t i = 0; i < count; ++i) {
+            double dx = xs[i] - q.x;
+            double dy = ys[i] - q.y;
+            double dz = zs[i] - q.z;
+            out[i] = dx * dx + dy * dy + dz * dz;
+        }
+    }
+}
 
 class Checkpoint {
 protected:
@@ -39,6 +95,12 @@ public:
 
     int sequence() const { return sequence_number; }
     const std::string& get_name() const { return name; }
+    double get_latitude() const { return latitude; }
+    double get_longitude() const { return longitude; }
+
+    double distance_to_km(const Checkpoint& other) const {
+        return Geo::haversine_km(latitude, longitude, other.latitude, other.longitude);
+    }
 };
 
 class MandatoryCheckpoint : public Checkpoint {
@@ -128,6 +190,525 @@ public:
     }
 };
 
+// Structure-of-arrays checkpoint storage: one contiguous column per field
+// and all names in a single string pool, so scans such as penalty sums
+// touch only the bytes they need and involve no virtual calls.
+class CheckpointStore {
+public:
+    enum class Kind : std::uint8_t { Mandatory, Optional };
+
+    void reserve(size_t count, size_t name_bytes = 0) {
+        latitudes_.reserve(count);
+        longitudes_.reserve(count);
+        sequences_.reserve(count);
+        penalties_.reserve(count);
+        kinds_.reserve(count);
+        name_offsets_.reserve(count + 1);
+        name_pool_.reserve(name_bytes);
+    }
+
+    // Validates like the Checkpoint classes. Mandatory checkpoints store a
+    // zero penalty so the penalty column can be summed without a mask.
+    void add(std::string_view name, double lat, double lon, int seq, Kind kind, double penalty = 0.0) {
+        double latitude = Checkpoint::validate_latitude(lat);
+        double longitude = Checkpoint::validate_longitude(lon);
+        int sequence = Checkpoint::validate_sequence(seq);
+        if (kind == Kind::Mandatory) penalty = 0.0;
+        if (penalty < 0) throw std::invalid_argument("Penalty cannot be negative");
+
+        latitudes_.push_back(latitude);
+        longitudes_.push_back(longitude);
+        sequences_.push_back(sequence);
+        penalties_.push_back(penalty);
+        kinds_.push_back(kind);
+        name_pool_.append(name);
+        name_offsets_.push_back(static_cast<std::uint32_t>(name_pool_.size()));
+    }
+
+    size_t size() const { return sequences_.size(); }
+    bool empty() const { return sequences_.empty(); }
+
+    std::string_view name(size_t index) const {
+        return std::string_view(name_pool_).substr(name_offsets_[index],
+                                                   name_offsets_[index + 1] - name_offsets_[index]);
+    }
+
+    const std::vector<double>& latitudes() const { return latitudes_; }
+    const std::vector<double>& longitudes() const { return longitudes_; }
+    const std::vector<int>& sequences() const { return sequences_; }
+    const std::vector<double>& penalties() const { return penalties_; }
+    const std::vector<Kind>& kinds() const { return kinds_; }
+
+    // Four independent accumulators let the compiler vectorize the loop
+    // without -ffast-math reassociation.
+    double total_penalty() const {
+        const double* values = penalties_.data();
+        size_t count = penalties_.size();
+        double sums[4] = {0.0, 0.0, 0.0, 0.0};
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            sums[0] += values[i];
+            sums[1] += values[i + 1];
+            sums[2] += values[i + 2];
+            sums[3] += values[i + 3];
+        }
+        for (; i < count; ++i) sums[0] += values[i];
+        return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+
+    // Stable sort of every column by sequence number. Sequence and index
+    // are packed into one 64-bit key (sequences are positive), so a plain
+    // integer sort is stable and never chases into the other columns.
+    void sort_by_sequence() {
+        std::vector<std::uint64_t> keys(size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            keys[i] = (static_cast<std::uint64_t>(sequences_[i]) << 32) | i;
+        }
+        std::sort(keys.begin(), keys.end());
+        std::vector<std::uint32_t> order(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) order[i] = static_cast<std::uint32_t>(keys[i]);
+
+        permute(latitudes_, order);
+        permute(longitudes_, order);
+        permute(sequences_, order);
+        permute(penalties_, order);
+        permute(kinds_, order);
+
+        std::string pool;
+        pool.reserve(name_pool_.size());
+        std::vector<std::uint32_t> offsets{0};
+        offsets.reserve(name_offsets_.size());
+        for (std::uint32_t index : order) {
+            pool.append(name(index));
+            offsets.push_back(static_cast<std::uint32_t>(pool.size()));
+        }
+        name_pool_ = std::move(pool);
+        name_offsets_ = std::move(offsets);
+    }
+
+    void print_info(size_t index) const {
+        std::cout << sequences_[index] << ". " << name(index) << "\n"
+                  << "  Coordinates: " << latitudes_[index] << " "
+                  << longitudes_[index] << "\n";
+        if (kinds_[index] == Kind::Mandatory) {
+            std::cout << "  Status: Mandatory\n\n";
+        } else {
+            std::cout << "  Penalty for skip: " << penalties_[index] << " hours\n\n";
+        }
+    }
+
+    void clear() {
+        latitudes_.clear();
+        longitudes_.clear();
+        sequences_.clear();
+        penalties_.clear();
+        kinds_.clear();
+        name_pool_.clear();
+        name_offsets_.assign(1, 0);
+    }
+
+private:
+    template <typename T>
+    static void permute(std::vector<T>& column, const std::vector<std::uint32_t>& order) {
+        std::vector<T> sorted;
+        sorted.reserve(column.size());
+        for (std::uint32_t index : order) sorted.push_back(column[index]);
+        column = std::move(sorted);
+    }
+
+    std::vector<double> latitudes_;
+    std::vector<double> longitudes_;
+    std::vector<int> sequences_;
+    std::vector<double> penalties_;
+    std::vector<Kind> kinds_;
+    std::string name_pool_;
+    std::vector<std::uint32_t> name_offsets_{0};
+};
+
+// Geometry over a CheckpointStore snapshot, taken in store order (call
+// sort_by_sequence() first to get route order): leg lengths, total route
+// length and nearest-checkpoint queries. Positions are kept as unit-vector
+// columns and indexed by a 3-d KD-tree whose leaves are contiguous runs of
+// those columns.
+class RouteGeometry {
+public:
+    struct Nearest {
+        size_t index = 0;
+        double distance_km = std::numeric_limits<double>::infinity();
+    };
+
+    explicit RouteGeometry(const CheckpointStore& store) {
+        size_t count = store.size();
+        std::vector<Geo::UnitVector> points(count);
+        for (size_t i = 0; i < count; ++i) {
+            points[i] = Geo::to_unit(store.latitudes()[i], store.longitudes()[i]);
+        }
+
+        legs_km_.reserve(count > 0 ? count - 1 : 0);
+        for (size_t i = 1; i < count; ++i) {
+            legs_km_.push_back(Geo::chord_squared_to_km(squared_distance(points[i - 1], points[i])));
+            total_km_ += legs_km_.back();
+        }
+
+        ids_.resize(count);
+        for (size_t i = 0; i < count; ++i) ids_[i] = static_cast<std::uint32_t>(i);
+        if (count > 0) build(points, 0, count);
+
+        xs_.resize(count);
+        ys_.resize(count);
+        zs_.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            const Geo::UnitVector& p = points[ids_[i]];
+            xs_[i] = p.x;
+            ys_[i] = p.y;
+            zs_[i] = p.z;
+        }
+    }
+
+    size_t size() const { return ids_.size(); }
+
+    // Distance from checkpoint index to index + 1.
+    double leg_distance_km(size_t index) const { return legs_km_.at(index); }
+    double total_length_km() const { return total_km_; }
+
+    Nearest nearest(double lat, double lon) const {
+        Nearest result;
+        if (nodes_.empty()) return result;
+        Geo::UnitVector q = Geo::to_unit(lat, lon);
+        double best = std::numeric_limits<double>::infinity();
+        size_t best_slot = 0;
+        search(0, q, best, best_slot);
+        result.index = ids_[best_slot];
+        result.distance_km = Geo::chord_squared_to_km(best);
+        return result;
+    }
+
+    void nearest_batch(std::span<const double> lats, std::span<const double> lons, std::span<Nearest> out) const {
+        for (size_t i = 0; i < lats.size(); ++i) out[i] = nearest(lats[i], lons[i]);
+    }
+
+    // Distance from one position to every checkpoint, in store order.
+    void distances_km(double lat, double lon, std::span<double> out) const {
+        std::vector<double> chords(size());
+        Geo::chord_squared_batch(xs_.data(), ys_.data(), zs_.data(), size(), Geo::to_unit(lat, lon), chords.data());
+        for (size_t i = 0; i < size(); ++i) out[ids_[i]] = Geo::chord_squared_to_km(chords[i]);
+    }
+
+private:
+    static constexpr size_t kLeafSize = 16;
+
+    // Inner nodes split [begin, end) at mid on one axis; leaves have
+    // left == -1 and cover [begin, end) of the columns.
+    struct Node {
+        double split;
+        std::uint32_t begin;
+        std::uint32_t end;
+        std::int32_t left;
+        std::int32_t right;
+        std::uint8_t axis;
+    };
+
+    static double coordinate(const Geo::UnitVector& p, int axis) {
+        return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+    }
+
+    static double squared_distance(const Geo::UnitVector& a, const Geo::UnitVector& b) {
+        double dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    std::int32_t build(const std::vector<Geo::UnitVector>& points, size_t begin, size_t end) {
+        auto index = static_cast<std::int32_t>(nodes_.size());
+        nodes_.push_back(Node{0.0, static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end), -1, -1, 0});
+        if (end - begin <= kLeafSize) return index;
+
+        double low[3] = {2, 2, 2}, high[3] = {-2, -2, -2};
+        for (size_t i = begin; i < end; ++i) {
+            for (int axis = 0; axis < 3; ++axis) {
+                double value = coordinate(points[ids_[i]], axis);
+                low[axis] = std::min(low[axis], value);
+                high[axis] = std::max(high[axis], value);
+            }
+        }
+        int axis = 0;
+        for (int a = 1; a < 3; ++a) {
+            if (high[a] - low[a] > high[axis] - low[axis]) axis = a;
+        }
+
+        size_t mid = begin + (end - begin) / 2;
+        std::nth_element(ids_.begin() + begin, ids_.begin() + mid, ids_.begin() + end,
+                         [&](std::uint32_t a, std::uint32_t b) {
+                             return coordinate(points[a], axis) < coordinate(points[b], axis);
+                         });
+        double split = coordinate(points[ids_[mid]], axis);
+        std::int32_t left = build(points, begin, mid);
+        std::int32_t right = build(points, mid, end);
+        Node& node = nodes_[index];
+        node.split = split;
+        node.axis = static_cast<std::uint8_t>(axis);
+        node.left = left;
+        node.right = right;
+        return index;
+    }
+
+    void search(std::int32_t index, const Geo::UnitVector& q, double& best, size_t& best_slot) const {
+        const Node& node = nodes_[index];
+        if (node.left < 0) {
+            double chords[kLeafSize];
+            size_t count = node.end - node.begin;
+            Geo::chord_squared_batch(xs_.data() + node.begin, ys_.data() + node.begin, zs_.data() + node.begin,
+                                     count, q, chords);
+            for (size_t i = 0; i < count; ++i) {
+                if (chords[i] < best) {
+                    best = chords[i];
+                    best_slot = node.begin + i;
+                }
+            }
+            return;
+        }
+        double diff = coordinate(q, node.axis) - node.split;
+        std::int32_t near = diff < 0 ? node.left : node.right;
+        std::int32_t far = diff < 0 ? node.right : node.left;
+        search(near, q, best, best_slot);
+        if (diff * diff < best) search(far, q, best, best_slot);
+    }
+
+    std::vector<double> legs_km_;
+    double total_km_ = 0.0;
+    std::vector<std::uint32_t> ids_;
+    std::vector<double> xs_;
+    std::vector<double> ys_;
+    std::vector<double> zs_;
+    std::vector<Node> nodes_;
+};
+
+// Builds the same report as TextReportBuilder from a CheckpointStore
+// instead of individually allocated Checkpoint objects.
+class ColumnarReportBuilder : public CheckpointReportBuilder {
+    CheckpointStore store_;
+
+public:
+    void add_mandatory(std::string name, double lat, double lon, int seq) override {
+        store_.add(name, lat, lon, seq, CheckpointStore::Kind::Mandatory);
+    }
+
+    void add_optional(std::string name, double lat, double lon, int seq, double penalty) override {
+        store_.add(name, lat, lon, seq, CheckpointStore::Kind::Optional, penalty);
+    }
+
+    void generate() override {
+        store_.sort_by_sequence();
+
+        std::cout << "Checkpoint list:\n";
+        for (size_t i = 0; i < store_.size(); ++i) {
+            store_.print_info(i);
+        }
+        std::cout << "Total penalty for skipped optional checkpoints: "
+                  << store_.total_penalty() << " hours\n";
+        std::cout << "Route length: " << RouteGeometry(store_).total_length_km() << " km\n";
+    }
+
+    const CheckpointStore& store() const { return store_; }
+    CheckpointStore& store() { return store_; }
+};
+
+// Writes every checkpoint it receives as a binary race record; paired with
+// StreamingRaceDirector this converts a CSV race into the binary format.
+class BinaryRaceWriter : public CheckpointReportBuilder {
+public:
+    static constexpr char kMagic[8] = {'R', 'A', 'C', 'E', 'B', 'I', 'N', '1'};
+
+    explicit BinaryRaceWriter(std::ostream& out) : out_(out) {
+        out_.write(kMagic, sizeof(kMagic));
+    }
+
+    void add_mandatory(std::string name, double lat, double lon, int seq) override {
+        write_record(0, name, lat, lon, seq, 0.0);
+    }
+
+    void add_optional(std::string name, double lat, double lon, int seq, double penalty) override {
+        write_record(1, name, lat, lon, seq, penalty);
+    }
+
+    void generate() override { out_.flush(); }
+
+private:
+    // Record: kind(1) latitude(8) longitude(8) sequence(4) penalty(8)
+    // name_length(2) name bytes.
+    void write_record(std::uint8_t kind, const std::string& name, double lat, double lon, int seq, double penalty) {
+        char record[31];
+        auto name_length = static_cast<std::uint16_t>(std::min<size_t>(name.size(), UINT16_MAX));
+        auto sequence = static_cast<std::int32_t>(seq);
+        record[0] = static_cast<char>(kind);
+        std::memcpy(record + 1, &lat, 8);
+        std::memcpy(record + 9, &lon, 8);
+        std::memcpy(record + 17, &sequence, 4);
+        std::memcpy(record + 21, &penalty, 8);
+        std::memcpy(record + 29, &name_length, 2);
+        out_.write(record, sizeof(record));
+        out_.write(name.data(), name_length);
+    }
+
+    std::ostream& out_;
+};
+
+// Reads a race from a stream in fixed-size chunks, validates each record
+// once and forwards it to every registered builder, so any number of
+// reports come out of a single pass. Memory use is bounded by the chunk
+// size (plus whatever the builders themselves keep).
+class StreamingRaceDirector {
+public:
+    struct Stats {
+        size_t accepted = 0;
+        size_t rejected = 0;
+    };
+
+    explicit StreamingRaceDirector(size_t chunk_size = 1 << 20) : chunk_size_(chunk_size) {}
+
+    void add_builder(CheckpointReportBuilder& builder) {
+        builders_.push_back(&builder);
+    }
+
+    // Detects the binary format by its magic, otherwise parses CSV. Calls
+    // generate() on every builder at the end.
+    Stats construct_race(std::istream& in) {
+        Stats stats;
+        char magic[sizeof(BinaryRaceWriter::kMagic)] = {};
+        in.read(magic, sizeof(magic));
+        std::string carry;
+        if (in.gcount() == sizeof(magic) && std::memcmp(magic, BinaryRaceWriter::kMagic, sizeof(magic)) == 0) {
+            read_chunks(in, carry, [&](std::string_view data) { return parse_binary(data, stats); });
+            if (!carry.empty()) ++stats.rejected;  // truncated final record
+        } else {
+            carry.assign(magic, static_cast<size_t>(in.gcount()));
+            read_chunks(in, carry, [&](std::string_view data) { return parse_csv(data, stats); });
+            // Whatever is left: lines of a tiny file that never filled a
+            // chunk, or a last line without a trailing newline.
+            size_t consumed = parse_csv(carry, stats);
+            parse_csv_line(std::string_view(carry).substr(consumed), stats);
+        }
+
+        for (CheckpointReportBuilder* builder : builders_) builder->generate();
+        return stats;
+    }
+
+private:
+    // Feeds carry + each chunk to parse, which returns how many bytes it
+    // consumed; the unconsumed tail is carried into the next round.
+    template <typename Parse>
+    void read_chunks(std::istream& in, std::string& carry, Parse parse) {
+        std::string buffer;
+        buffer.reserve(chunk_size_ * 2);
+        std::vector<char> chunk(chunk_size_);
+        for (;;) {
+            in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            auto got = static_cast<size_t>(in.gcount());
+            if (got == 0) break;
+            buffer.assign(carry);
+            buffer.append(chunk.data(), got);
+            size_t consumed = parse(std::string_view(buffer));
+            carry.assign(buffer, consumed, std::string::npos);
+        }
+    }
+
+    size_t parse_csv(std::string_view data, Stats& stats) {
+        size_t start = 0;
+        for (size_t end; (end = data.find('\n', start)) != std::string_view::npos; start = end + 1) {
+            parse_csv_line(data.substr(start, end - start), stats);
+        }
+        return start;
+    }
+
+    // type,name,latitude,longitude,sequence[,penalty] where type is
+    // "mandatory" or "optional". Blank lines, '#' comments and a header
+    // line starting with "type" are skipped.
+    void parse_csv_line(std::string_view line, Stats& stats) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty() || line.front() == '#' || line.starts_with("type,")) return;
+
+        std::string_view fields[6];
+        size_t count = 0;
+        while (count < 6) {
+            size_t comma = line.find(',');
+            fields[count++] = line.substr(0, comma);
+            if (comma == std::string_view::npos) break;
+            line.remove_prefix(comma + 1);
+        }
+
+        double lat = 0, lon = 0, penalty = 0;
+        int seq = 0;
+        bool optional = fields[0] == "optional";
+        bool ok = (optional || fields[0] == "mandatory") && count == (optional ? 6u : 5u) &&
+                  parse_number(fields[2], lat) && parse_number(fields[3], lon) && parse_number(fields[4], seq) &&
+                  (!optional || parse_number(fields[5], penalty));
+        if (!ok) {
+            ++stats.rejected;
+            return;
+        }
+        dispatch(optional, fields[1], lat, lon, seq, penalty, stats);
+    }
+
+    size_t parse_binary(std::string_view data, Stats& stats) {
+        constexpr size_t kFixed = 31;
+        size_t offset = 0;
+        while (data.size() - offset >= kFixed) {
+            const char* record = data.data() + offset;
+            double lat, lon, penalty;
+            std::int32_t seq;
+            std::uint16_t name_length;
+            std::memcpy(&lat, record + 1, 8);
+            std::memcpy(&lon, record + 9, 8);
+            std::memcpy(&seq, record + 17, 4);
+            std::memcpy(&penalty, record + 21, 8);
+            std::memcpy(&name_length, record + 29, 2);
+            if (data.size() - offset < kFixed + name_length) break;
+
+            std::string_view name(record + kFixed, name_length);
+            auto kind = static_cast<std::uint8_t>(record[0]);
+            if (kind > 1) {
+                ++stats.rejected;
+            } else {
+                dispatch(kind == 1, name, lat, lon, seq, penalty, stats);
+            }
+            offset += kFixed + name_length;
+        }
+        return offset;
+    }
+
+    void dispatch(bool optional, std::string_view name, double lat, double lon, int seq, double penalty,
+                  Stats& stats) {
+        try {
+            Checkpoint::validate_latitude(lat);
+            Checkpoint::validate_longitude(lon);
+            Checkpoint::validate_sequence(seq);
+            if (optional && penalty < 0) throw std::invalid_argument("Penalty cannot be negative");
+        } catch (const std::invalid_argument&) {
+            ++stats.rejected;
+            return;
+        }
+
+        for (CheckpointReportBuilder* builder : builders_) {
+            if (optional) {
+                builder->add_optional(std::string(name), lat, lon, seq, penalty);
+            } else {
+                builder->add_mandatory(std::string(name), lat, lon, seq);
+            }
+        }
+        ++stats.accepted;
+    }
+
+    template <typename T>
+    static bool parse_number(std::string_view text, T& value) {
+        while (!text.empty() && text.front() == ' ') text.remove_prefix(1);
+        while (!text.empty() && text.back() == ' ') text.remove_suffix(1);
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return error == std::errc() && end == text.data() + text.size();
+    }
+
+    size_t chunk_size_;
+    std::vector<CheckpointReportBuilder*> builders_;
+};
+
 class RaceDirector {
 public:
     void construct_race(CheckpointReportBuilder& builder) {
@@ -141,7 +722,135 @@ public:
 };
 
 
-int main() {
+// Compares sorting and penalty summation over count checkpoints stored as
+// polymorphic objects and as columns.
+void run_columnar_benchmark(size_t count) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> lat(-90.0, 90.0);
+    std::uniform_real_distribution<double> lon(-180.0, 180.0);
+    std::uniform_int_distribution<int> seq(1, static_cast<int>(count));
+    std::uniform_real_distribution<double> penalty(0.0, 5.0);
+
+    std::vector<std::unique_ptr<Checkpoint>> objects;
+    CheckpointStore store;
+    objects.reserve(count);
+    store.reserve(count, count * 12);
+    for (size_t i = 0; i < count; ++i) {
+        std::string name = "Checkpoint " + std::to_string(i);
+        double la = lat(rng), lo = lon(rng), pen = penalty(rng);
+        int sq = seq(rng);
+        if (i % 2 == 0) {
+            objects.push_back(std::make_unique<MandatoryCheckpoint>(name, la, lo, sq));
+            store.add(name, la, lo, sq, CheckpointStore::Kind::Mandatory);
+        } else {
+            objects.push_back(std::make_unique<OptionalCheckpoint>(name, la, lo, sq, pen));
+            store.add(name, la, lo, sq, CheckpointStore::Kind::Optional, pen);
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    auto start = Clock::now();
+    double object_total = 0.0;
+    for (const auto& cp : objects) object_total += cp->get_penalty();
+    auto summed = Clock::now();
+    std::stable_sort(objects.begin(), objects.end(),
+                     [](const auto& a, const auto& b) { return a->sequence() < b->sequence(); });
+    auto sorted = Clock::now();
+
+    double store_total = store.total_penalty();
+    auto store_summed = Clock::now();
+    store.sort_by_sequence();
+    auto store_sorted = Clock::now();
+
+    std::cout << count << " checkpoints\n"
+              << "  objects: penalty sum " << ms(summed - start) << " ms, sort " << ms(sorted - summed) << " ms\n"
+              << "  columns: penalty sum " << ms(store_summed - sorted) << " ms, sort "
+              << ms(store_sorted - store_summed) << " ms\n"
+              << "  totals: " << object_total << " / " << store_total << std::endl;
+}
+
+// Nearest-checkpoint lookups for random pings: KD-tree over unit vectors
+// against a scalar haversine scan of every checkpoint.
+void run_geo_benchmark(size_t checkpoints, size_t pings) {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> lat(40.0, 56.0);
+    std::uniform_real_distribution<double> lon(30.0, 50.0);
+
+    CheckpointStore store;
+    store.reserve(checkpoints);
+    for (size_t i = 0; i < checkpoints; ++i) {
+        store.add("CP", lat(rng), lon(rng), static_cast<int>(i + 1), CheckpointStore::Kind::Mandatory);
+    }
+    std::vector<double> ping_lats(pings), ping_lons(pings);
+    for (size_t i = 0; i < pings; ++i) {
+        ping_lats[i] = lat(rng);
+        ping_lons[i] = lon(rng);
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    RouteGeometry geometry(store);
+    auto built = Clock::now();
+    std::vector<RouteGeometry::Nearest> indexed(pings);
+    geometry.nearest_batch(ping_lats, ping_lons, indexed);
+    auto queried = Clock::now();
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < pings; ++i) {
+        double best = std::numeric_limits<double>::infinity();
+        for (size_t c = 0; c < checkpoints; ++c) {
+            best = std::min(best, Geo::haversine_km(ping_lats[i], ping_lons[i], store.latitudes()[c],
+                                                    store.longitudes()[c]));
+        }
+        if (std::abs(best - indexed[i].distance_km) > 1e-6) ++mismatches;
+    }
+    auto scanned = Clock::now();
+
+    auto seconds = [](Clock::duration d) { return std::chrono::duration<double>(d).count(); };
+    std::cout << checkpoints << " checkpoints, route " << geometry.total_length_km() << " km\n"
+              << "  index build: " << seconds(built - start) * 1000 << " ms\n"
+              << "  kd-tree:     " << pings / seconds(queried - built) << " pings/s\n"
+              << "  brute force: " << pings / seconds(scanned - queried) << " pings/s\n"
+              << "  mismatches:  " << mismatches << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::strcmp(argv[1], "--bench-geo") == 0) {
+        run_geo_benchmark(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5000,
+                          argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 20000);
+        return 0;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-columnar") == 0) {
+        run_columnar_benchmark(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2'000'000);
+        return 0;
+    }
+    // --stream <race file> [binary output]: one pass over a CSV or binary
+    // race, feeding the penalty calculator and optionally a binary writer.
+    if (argc > 2 && std::strcmp(argv[1], "--stream") == 0) {
+        std::ifstream in(argv[2], std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open " << argv[2] << "\n";
+            return 1;
+        }
+        StreamingRaceDirector streaming;
+        PenaltyCalculator penalty;
+        streaming.add_builder(penalty);
+
+        std::ofstream out;
+        std::unique_ptr<BinaryRaceWriter> writer;
+        if (argc > 3) {
+            out.open(argv[3], std::ios::binary);
+            writer = std::make_unique<BinaryRaceWriter>(out);
+            streaming.add_builder(*writer);
+        }
+
+        auto stats = streaming.construct_race(in);
+        std::cout << "Accepted " << stats.accepted << " checkpoints, rejected " << stats.rejected << "\n";
+        return 0;
+    }
+
     RaceDirector director;
 
     TextReportBuilder text_builder;
@@ -150,5 +859,8 @@ int main() {
     PenaltyCalculator penalty_calc;
     director.construct_race(penalty_calc);
 
+    ColumnarReportBuilder columnar_builder;
+    director.construct_race(columnar_builder);
+
     return 0;
 }
\ No newline at end of file
@@ -3,82 +3,301 @@
 #include <unordered_set>
 #include <memory>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <bit>
+#include <climits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <span>
+#include <thread>
+#include <exception>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Stored in every impl so Set can tell them apart without dynamic_cast.
+enum class SetKind : std::uint8_t { Vector, Hash, FlatHash, Bitmap };
+
+// Callback for element traversal. Impls hand elements over in chunks, so
+// the indirect call is paid once per block instead of once per element.
+class ChunkVisitor {
+    void* context;
+    void (*call)(void*, const int*, size_t);
+
+public:
+    template <typename F>
+        requires(!std::is_same_v<F, ChunkVisitor>)
+    ChunkVisitor(F& f)
+        : context(&f), call([](void* c, const int* values, size_t count) { (*static_cast<F*>(c))(values, count); }) {}
+
+    void operator()(const int* values, size_t count) const { call(context, values, count); }
+};
+
+// Collects single elements into a stack buffer for a ChunkVisitor.
+class ChunkWriter {
+    static constexpr size_t CAPACITY = 256;
+
+    ChunkVisitor visit;
+    int buffer[CAPACITY];
+    size_t used = 0;
+
+public:
+    explicit ChunkWriter(ChunkVisitor v) : visit(v) {}
+    ~ChunkWriter() { flush(); }
+
+    void push(int value) {
+        buffer[used++] = value;
+        if (used == CAPACITY) flush();
+    }
+
+    void flush() {
+        if (used > 0) visit(buffer, used);
+        used = 0;
+    }
+};
 
 class SetImpl {
+    SetKind kind_;
+
 public:
+    explicit SetImpl(SetKind kind) : kind_(kind) {}
     virtual ~SetImpl() = default;
+
+    SetKind kind() const { return kind_; }
+
     virtual void add(int value) = 0;
     virtual void remove(int value) = 0;
     virtual bool contains(int value) const = 0;
     virtual size_t size() const = 0;
+    virtual void reserve(size_t) {}
+
+    // Inserts count values (duplicates allowed) at once, sizing storage
+    // for all of them up front.
+    virtual void add_bulk(const int* values, size_t count) {
+        reserve(size() + count);
+        for (size_t i = 0; i < count; ++i) add(values[i]);
+    }
+
+    virtual void contains_batch(const int* values, size_t count, bool* out) const {
+        for (size_t i = 0; i < count; ++i) out[i] = contains(values[i]);
+    }
+    // Approximate heap and object footprint in bytes.
+    virtual size_t memory_bytes() const = 0;
+    // Smallest and largest element; only meaningful when size() > 0.
+    virtual std::pair<int, int> bounds() const = 0;
     virtual std::unique_ptr<SetImpl> clone() const = 0;
     virtual std::vector<int> get_elements() const = 0;
+    // Calls visit with every element, in chunks; sorted for the vector and
+    // bitmap impls.
+    virtual void for_each_chunk(ChunkVisitor visit) const = 0;
     virtual void print() const = 0;
 
-    virtual std::unique_ptr<SetImpl> union_with(const SetImpl& other) const = 0;
-    virtual std::unique_ptr<SetImpl> intersection_with(const SetImpl& other) const = 0;
+    // In-place set algebra; `other` must be a different object. Each impl
+    // checks other.kind() for a fast path against its own kind and falls
+    // back to chunked traversal or contains() probes otherwise.
+    virtual void unite(const SetImpl& other) = 0;
+    virtual void intersect(const SetImpl& other) = 0;
+    virtual void subtract(const SetImpl& other) = 0;
+
+    template <typename F>
+    void for_each(F&& f) const {
+        auto visit = [&](const int* values, size_t count) {
+            for (size_t i = 0; i < count; ++i) f(values[i]);
+        };
+        for_each_chunk(ChunkVisitor(visit));
+    }
+
+    // Copies the larger operand and merges the smaller one into it.
+    std::unique_ptr<SetImpl> union_with(const SetImpl& other) const {
+        bool keep_this = size() >= other.size();
+        auto result = (keep_this ? *this : other).clone();
+        result->unite(keep_this ? other : *this);
+        return result;
+    }
+
+    // Copies the smaller operand and probes its elements in the larger one.
+    std::unique_ptr<SetImpl> intersection_with(const SetImpl& other) const {
+        bool keep_this = size() <= other.size();
+        auto result = (keep_this ? *this : other).clone();
+        result->intersect(keep_this ? other : *this);
+        return result;
+    }
+
+    std::unique_ptr<SetImpl> difference_with(const SetImpl& other) const {
+        auto result = clone();
+        result->subtract(other);
+        return result;
+    }
 };
 
-class VectorSetImpl : public SetImpl {
+// Sorted vector for small sets. Searches scan the whole array four lanes
+// at a time instead of bisecting; at the sizes this impl is used for that
+// is cheaper than a binary search's unpredictable branches.
+class VectorSetImpl final : public SetImpl {
     std::vector<int> data;
 
+    // Number of elements below value, i.e. its insertion position.
+    size_t lower_bound_index(int value) const {
+        size_t index = 0;
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128i key = _mm_set1_epi32(value);
+        __m128i below = _mm_setzero_si128();
+        for (; i + 4 <= data.size(); i += 4) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data.data() + i));
+            below = _mm_sub_epi32(below, _mm_cmplt_epi32(chunk, key));
+        }
+        alignas(16) std::int32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), below);
+        index = static_cast<size_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#endif
+        for (; i < data.size(); ++i) index += data[i] < value;
+        return index;
+    }
+
 public:
+    VectorSetImpl() : SetImpl(SetKind::Vector) {}
+
+    // Takes ownership of values that are already sorted and unique.
+    static std::unique_ptr<VectorSetImpl> from_sorted(std::vector<int> values) {
+        auto result = std::make_unique<VectorSetImpl>();
+        result->data = std::move(values);
+        return result;
+    }
+
     void add(int value) override {
-        if (std::find(data.begin(), data.end(), value) == data.end()) {
-            data.push_back(value);
+        size_t index = lower_bound_index(value);
+        if (index == data.size() || data[index] != value) {
+            data.insert(data.begin() + static_cast<std::ptrdiff_t>(index), value);
         }
     }
 
     void remove(int value) override {
-        data.erase(std::remove(data.begin(), data.end(), value), data.end());
+        size_t index = lower_bound_index(value);
+        if (index < data.size() && data[index] == value) {
+            data.erase(data.begin() + static_cast<std::ptrdiff_t>(index));
+        }
     }
 
     bool contains(int value) const override {
-        return std::find(data.begin(), data.end(), value) != data.end();
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128i key = _mm_set1_epi32(value);
+        for (; i + 4 <= data.size(); i += 4) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data.data() + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(chunk, key)) != 0) return true;
+        }
+#endif
+        for (; i < data.size(); ++i) {
+            if (data[i] == value) return true;
+        }
+        return false;
     }
 
     size_t size() const override { return data.size(); }
 
+    void reserve(size_t count) override { data.reserve(count); }
+
+    void add_bulk(const int* values, size_t count) override {
+        size_t old_size = data.size();
+        data.insert(data.end(), values, values + count);
+        std::sort(data.begin() + static_cast<std::ptrdiff_t>(old_size), data.end());
+        std::inplace_merge(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(old_size), data.end());
+        data.erase(std::unique(data.begin(), data.end()), data.end());
+    }
+
+    size_t memory_bytes() const override { return sizeof(*this) + data.capacity() * sizeof(int); }
+
+    std::pair<int, int> bounds() const override { return {data.front(), data.back()}; }
+
     std::unique_ptr<SetImpl> clone() const override {
-        auto copy = std::make_unique<VectorSetImpl>();
-        copy->data = data;
-        return copy;
+        return from_sorted(data);
     }
 
     std::vector<int> get_elements() const override { return data; }
 
+    void for_each_chunk(ChunkVisitor visit) const override {
+        if (!data.empty()) visit(data.data(), data.size());
+    }
+
     void print() const override {
         std::cout << "VectorSet[ ";
         for (int v : data) std::cout << v << " ";
         std::cout << "]\n";
     }
 
-    std::unique_ptr<SetImpl> union_with(const SetImpl& other) const override {
-        auto result = std::make_unique<VectorSetImpl>();
-        result->data = this->data;
-        for (int val : other.get_elements()) {
-            if (!contains(val)) {
-                result->data.push_back(val);
+    void unite(const SetImpl& other) override {
+        size_t old_size = data.size();
+        if (other.kind() == SetKind::Vector) {
+            // Merge from the back so the result is built in data's own storage.
+            const std::vector<int>& theirs = static_cast<const VectorSetImpl&>(other).data;
+            data.resize(old_size + theirs.size());
+            size_t i = old_size, j = theirs.size(), out = data.size();
+            while (j > 0) {
+                if (i > 0 && data[i - 1] > theirs[j - 1]) {
+                    data[--out] = data[--i];
+                } else {
+                    data[--out] = theirs[--j];
+                }
             }
+        } else {
+            data.reserve(old_size + other.size());
+            auto append = [&](const int* values, size_t count) { data.insert(data.end(), values, values + count); };
+            other.for_each_chunk(ChunkVisitor(append));
+            if (other.kind() != SetKind::Bitmap) std::sort(data.begin() + static_cast<std::ptrdiff_t>(old_size), data.end());
+            std::inplace_merge(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(old_size), data.end());
         }
-        return result;
+        data.erase(std::unique(data.begin(), data.end()), data.end());
     }
 
-    std::unique_ptr<SetImpl> intersection_with(const SetImpl& other) const override {
-        auto result = std::make_unique<VectorSetImpl>();
-        for (int val : data) {
-            if (other.contains(val)) {
-                result->data.push_back(val);
+    void intersect(const SetImpl& other) override {
+        if (other.kind() == SetKind::Vector) {
+            const std::vector<int>& theirs = static_cast<const VectorSetImpl&>(other).data;
+            size_t out = 0;
+            for (size_t i = 0, j = 0; i < data.size() && j < theirs.size();) {
+                if (data[i] < theirs[j]) {
+                    ++i;
+                } else if (theirs[j] < data[i]) {
+                    ++j;
+                } else {
+                    data[out++] = data[i++];
+                    ++j;
+                }
             }
+            data.resize(out);
+        } else {
+            std::erase_if(data, [&](int v) { return !other.contains(v); });
+        }
+    }
+
+    void subtract(const SetImpl& other) override {
+        if (other.kind() == SetKind::Vector) {
+            const std::vector<int>& theirs = static_cast<const VectorSetImpl&>(other).data;
+            size_t out = 0;
+            size_t j = 0;
+            for (size_t i = 0; i < data.size(); ++i) {
+                while (j < theirs.size() && theirs[j] < data[i]) ++j;
+                if (j == theirs.size() || theirs[j] != data[i]) data[out++] = data[i];
+            }
+            data.resize(out);
+        } else {
+            std::erase_if(data, [&](int v) { return other.contains(v); });
         }
-        return result;
     }
 };
 
-class HashSetImpl : public SetImpl {
+class HashSetImpl final : public SetImpl {
     std::unordered_set<int> data;
 
 public:
+    HashSetImpl() : SetImpl(SetKind::Hash) {}
+
     void add(int value) override { data.insert(value); }
 
     void remove(int value) override { data.erase(value); }
@@ -87,6 +306,24 @@ public:
 
     size_t size() const override { return data.size(); }
 
+    void reserve(size_t count) override { data.reserve(count); }
+
+    void add_bulk(const int* values, size_t count) override {
+        data.reserve(data.size() + count);
+        data.insert(values, values + count);
+    }
+
+    // One node per element (next pointer plus value), rounded up to the
+    // 32-byte minimum chunk of a typical malloc, plus the bucket array.
+    size_t memory_bytes() const override {
+        return sizeof(*this) + data.bucket_count() * sizeof(void*) + data.size() * 32;
+    }
+
+    std::pair<int, int> bounds() const override {
+        auto [lo, hi] = std::minmax_element(data.begin(), data.end());
+        return {*lo, *hi};
+    }
+
     std::unique_ptr<SetImpl> clone() const override {
         auto copy = std::make_unique<HashSetImpl>();
         copy->data = data;
@@ -97,87 +334,1442 @@ public:
         return std::vector<int>(data.begin(), data.end());
     }
 
+    void for_each_chunk(ChunkVisitor visit) const override {
+        ChunkWriter out(visit);
+        for (int v : data) out.push(v);
+    }
+
     void print() const override {
         std::cout << "HashSet{ ";
         for (int v : data) std::cout << v << " ";
         std::cout << "}\n";
     }
 
-    std::unique_ptr<SetImpl> union_with(const SetImpl& other) const override {
-        auto result = std::make_unique<HashSetImpl>();
-        result->data = this->data;
-        for (int val : other.get_elements()) {
-            result->data.insert(val);
+    void unite(const SetImpl& other) override {
+        data.reserve(data.size() + other.size());
+        auto insert = [&](const int* values, size_t count) { data.insert(values, values + count); };
+        other.for_each_chunk(ChunkVisitor(insert));
+    }
+
+    void intersect(const SetImpl& other) override {
+        // When other is much smaller, probing its elements here and keeping
+        // the hits touches far fewer nodes than filtering this set.
+        if (other.size() * 4 < data.size()) {
+            std::unordered_set<int> kept;
+            kept.reserve(other.size());
+            auto probe = [&](const int* values, size_t count) {
+                for (size_t i = 0; i < count; ++i) {
+                    if (data.count(values[i])) kept.insert(values[i]);
+                }
+            };
+            other.for_each_chunk(ChunkVisitor(probe));
+            data.swap(kept);
+        } else if (other.kind() == SetKind::Hash) {
+            const auto& theirs = static_cast<const HashSetImpl&>(other).data;
+            std::erase_if(data, [&](int v) { return !theirs.count(v); });
+        } else {
+            std::erase_if(data, [&](int v) { return !other.contains(v); });
+        }
+    }
+
+    void subtract(const SetImpl& other) override {
+        if (other.size() < data.size()) {
+            auto erase = [&](const int* values, size_t count) {
+                for (size_t i = 0; i < count; ++i) data.erase(values[i]);
+            };
+            other.for_each_chunk(ChunkVisitor(erase));
+        } else {
+            std::erase_if(data, [&](int v) { return other.contains(v); });
+        }
+    }
+};
+
+// Open addressing with linear probing over two flat arrays: no per-element
+// nodes, and a probe usually stays within one cache line. Removal shifts
+// the following cluster back instead of leaving tombstones.
+class FlatHashSetImpl final : public SetImpl {
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    std::vector<int> slots;
+    std::vector<std::uint8_t> used;
+    size_t count = 0;
+    size_t mask = 0;
+    unsigned shift = 64;
+
+    size_t home(int value) const {
+        auto key = static_cast<std::uint64_t>(static_cast<std::uint32_t>(value));
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    size_t find_slot(int value) const {
+        if (slots.empty()) return SIZE_MAX;
+        for (size_t i = home(value); used[i]; i = (i + 1) & mask) {
+            if (slots[i] == value) return i;
+        }
+        return SIZE_MAX;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<int> old_slots = std::move(slots);
+        std::vector<std::uint8_t> old_used = std::move(used);
+        slots.assign(capacity, 0);
+        used.assign(capacity, 0);
+        mask = capacity - 1;
+        shift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) --shift;
+        for (size_t i = 0; i < old_slots.size(); ++i) {
+            if (old_used[i]) insert_new(old_slots[i]);
+        }
+    }
+
+    void insert_new(int value) {
+        size_t i = home(value);
+        while (used[i]) i = (i + 1) & mask;
+        slots[i] = value;
+        used[i] = 1;
+    }
+
+    // Keeps the load factor at or below 3/4.
+    static size_t capacity_for(size_t elements) {
+        size_t capacity = MIN_CAPACITY;
+        while (capacity * 3 < elements * 4) capacity *= 2;
+        return capacity;
+    }
+
+    // Drops every element failing keep. A few drops go through remove(),
+    // whose backward shift keeps every probe chain intact; past a quarter
+    // of the elements the survivors are rehashed into a fresh table instead.
+    template <typename Pred>
+    void retain_if(Pred keep) {
+        if (count == 0) return;
+        std::vector<std::uint8_t> kept(slots.size());
+        size_t survivors = 0;
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (used[i] && keep(slots[i])) {
+                kept[i] = 1;
+                ++survivors;
+            }
+        }
+        size_t dropped = count - survivors;
+        if (dropped == 0) return;
+        if (dropped * 4 <= count) {
+            std::vector<int> doomed;
+            doomed.reserve(dropped);
+            for (size_t i = 0; i < slots.size(); ++i) {
+                if (used[i] && !kept[i]) doomed.push_back(slots[i]);
+            }
+            for (int value : doomed) remove(value);
+            return;
+        }
+        FlatHashSetImpl rebuilt;
+        if (survivors > 0) rebuilt.rehash(capacity_for(survivors));
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (kept[i]) rebuilt.insert_new(slots[i]);
+        }
+        rebuilt.count = survivors;
+        *this = std::move(rebuilt);
+    }
+
+public:
+    FlatHashSetImpl() : SetImpl(SetKind::FlatHash) {}
+
+    void add(int value) override {
+        if (find_slot(value) != SIZE_MAX) return;
+        if (slots.empty() || (count + 1) * 4 > slots.size() * 3) {
+            rehash(capacity_for(count + 1));
+        }
+        insert_new(value);
+        ++count;
+    }
+
+    void remove(int value) override {
+        size_t hole = find_slot(value);
+        if (hole == SIZE_MAX) return;
+        for (size_t next = (hole + 1) & mask; used[next]; next = (next + 1) & mask) {
+            size_t want = home(slots[next]);
+            // Move the entry back unless its home lies cyclically in (hole, next].
+            bool stays = hole <= next ? (hole < want && want <= next) : (hole < want || want <= next);
+            if (!stays) {
+                slots[hole] = slots[next];
+                hole = next;
+            }
+        }
+        used[hole] = 0;
+        --count;
+    }
+
+    bool contains(int value) const override { return find_slot(value) != SIZE_MAX; }
+
+    size_t size() const override { return count; }
+
+    void reserve(size_t elements) override {
+        if (capacity_for(elements) > slots.size()) rehash(capacity_for(elements));
+    }
+
+    // Probes in blocks: every home slot of a block is prefetched before the
+    // first one is read, so the cache misses overlap instead of queueing.
+    void contains_batch(const int* values, size_t n, bool* out) const override {
+        constexpr size_t BLOCK = 16;
+        if (slots.empty()) {
+            std::fill(out, out + n, false);
+            return;
+        }
+        size_t homes[BLOCK];
+        for (size_t base = 0; base < n; base += BLOCK) {
+            size_t block = std::min(BLOCK, n - base);
+            for (size_t i = 0; i < block; ++i) {
+                homes[i] = home(values[base + i]);
+                __builtin_prefetch(&slots[homes[i]]);
+                __builtin_prefetch(&used[homes[i]]);
+            }
+            for (size_t i = 0; i < block; ++i) {
+                bool found = false;
+                for (size_t j = homes[i]; used[j]; j = (j + 1) & mask) {
+                    if (slots[j] == values[base + i]) {
+                        found = true;
+                        break;
+                    }
+                }
+                out[base + i] = found;
+            }
+        }
+    }
+
+    size_t memory_bytes() const override {
+        return sizeof(*this) + slots.capacity() * sizeof(int) + used.capacity();
+    }
+
+    std::pair<int, int> bounds() const override {
+        std::pair<int, int> result{INT_MAX, INT_MIN};
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (used[i]) {
+                result.first = std::min(result.first, slots[i]);
+                result.second = std::max(result.second, slots[i]);
+            }
+        }
+        return result;
+    }
+
+    std::unique_ptr<SetImpl> clone() const override {
+        return std::make_unique<FlatHashSetImpl>(*this);
+    }
+
+    std::vector<int> get_elements() const override {
+        std::vector<int> result;
+        result.reserve(count);
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (used[i]) result.push_back(slots[i]);
         }
         return result;
     }
 
-    std::unique_ptr<SetImpl> intersection_with(const SetImpl& other) const override {
-        auto result = std::make_unique<HashSetImpl>();
-        for (int val : data) {
-            if (other.contains(val)) {
-                result->data.insert(val);
+    void for_each_chunk(ChunkVisitor visit) const override {
+        ChunkWriter out(visit);
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (used[i]) out.push(slots[i]);
+        }
+    }
+
+    void print() const override {
+        std::cout << "FlatHashSet{ ";
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (used[i]) std::cout << slots[i] << " ";
+        }
+        std::cout << "}\n";
+    }
+
+    void unite(const SetImpl& other) override {
+        reserve(count + other.size());
+        if (other.kind() == SetKind::FlatHash) {
+            const auto& theirs = static_cast<const FlatHashSetImpl&>(other);
+            for (size_t i = 0; i < theirs.slots.size(); ++i) {
+                if (theirs.used[i]) add(theirs.slots[i]);
+            }
+            return;
+        }
+        auto insert = [&](const int* values, size_t count) {
+            for (size_t i = 0; i < count; ++i) add(values[i]);
+        };
+        other.for_each_chunk(ChunkVisitor(insert));
+    }
+
+    void intersect(const SetImpl& other) override {
+        if (other.size() * 4 < count) {
+            FlatHashSetImpl kept;
+            kept.reserve(other.size());
+            auto probe = [&](const int* values, size_t n) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (contains(values[i])) kept.add(values[i]);
+                }
+            };
+            other.for_each_chunk(ChunkVisitor(probe));
+            *this = std::move(kept);
+        } else if (other.kind() == SetKind::FlatHash) {
+            const auto& theirs = static_cast<const FlatHashSetImpl&>(other);
+            retain_if([&](int v) { return theirs.contains(v); });
+        } else {
+            retain_if([&](int v) { return other.contains(v); });
+        }
+    }
+
+    void subtract(const SetImpl& other) override {
+        if (other.size() < count) {
+            auto erase = [&](const int* values, size_t n) {
+                for (size_t i = 0; i < n; ++i) remove(values[i]);
+            };
+            other.for_each_chunk(ChunkVisitor(erase));
+        } else {
+            retain_if([&](int v) { return !other.contains(v); });
+        }
+    }
+};
+
+// Roaring-style compressed bitmap for dense integer sets. Values are
+// grouped by their high 16 bits; each group keeps its low 16 bits as a
+// sorted array (up to ARRAY_MAX values), a 65536-bit bitmap, or a list of
+// runs, whichever is smallest. Union and intersection work one container
+// pair at a time, bitmap pairs 128 bits per instruction.
+class BitmapSetImpl final : public SetImpl {
+    static constexpr size_t ARRAY_MAX = 4096;
+    static constexpr size_t BITMAP_WORDS = 65536 / 64;
+
+    // Inclusive range of low halves.
+    struct Run {
+        std::uint16_t start;
+        std::uint16_t last;
+    };
+
+    static void set_range(std::vector<std::uint64_t>& words, unsigned first, unsigned last) {
+        for (unsigned v = first; v <= last;) {
+            if ((v & 63) == 0 && v + 63 <= last) {
+                words[v >> 6] = ~0ull;
+                v += 64;
+            } else {
+                words[v >> 6] |= 1ull << (v & 63);
+                ++v;
+            }
+        }
+    }
+
+    enum class WordOp { Or, And, AndNot };
+
+    // out = a op b over one bitmap, 128 bits per step; out may alias a.
+    static void combine_words(std::uint64_t* out, const std::uint64_t* a, const std::uint64_t* b, WordOp op) {
+#if defined(__SSE2__)
+        for (size_t i = 0; i < BITMAP_WORDS; i += 2) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            __m128i r = op == WordOp::Or ? _mm_or_si128(x, y)
+                        : op == WordOp::And ? _mm_and_si128(x, y)
+                                            : _mm_andnot_si128(y, x);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), r);
+        }
+#else
+        for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+            out[i] = op == WordOp::Or ? a[i] | b[i] : op == WordOp::And ? a[i] & b[i] : a[i] & ~b[i];
+        }
+#endif
+    }
+
+    static std::uint32_t popcount_words(const std::vector<std::uint64_t>& words) {
+        std::uint32_t total = 0;
+        for (std::uint64_t w : words) total += static_cast<std::uint32_t>(std::popcount(w));
+        return total;
+    }
+
+    struct Container {
+        enum class Type : std::uint8_t { Array, Bitmap, Runs };
+
+        Type type = Type::Array;
+        std::uint32_t cardinality = 0;
+        std::vector<std::uint16_t> array;
+        std::vector<std::uint64_t> bits;
+        std::vector<Run> runs;
+
+        template <typename F>
+        void for_each(F&& f) const {
+            switch (type) {
+                case Type::Array:
+                    for (std::uint16_t v : array) f(v);
+                    break;
+                case Type::Bitmap:
+                    for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+                        for (std::uint64_t w = bits[i]; w != 0; w &= w - 1) {
+                            f(static_cast<std::uint16_t>(i * 64 + static_cast<size_t>(std::countr_zero(w))));
+                        }
+                    }
+                    break;
+                case Type::Runs:
+                    for (const Run& r : runs) {
+                        for (unsigned v = r.start; v <= r.last; ++v) f(static_cast<std::uint16_t>(v));
+                    }
+                    break;
+            }
+        }
+
+        bool contains(std::uint16_t low) const {
+            switch (type) {
+                case Type::Array:
+                    return std::binary_search(array.begin(), array.end(), low);
+                case Type::Bitmap:
+                    return (bits[low >> 6] >> (low & 63)) & 1;
+                case Type::Runs: {
+                    auto it = std::upper_bound(runs.begin(), runs.end(), low,
+                                               [](std::uint16_t v, const Run& r) { return v < r.start; });
+                    return it != runs.begin() && low <= std::prev(it)->last;
+                }
+            }
+            return false;
+        }
+
+        std::uint16_t min_low() const {
+            if (type == Type::Array) return array.front();
+            if (type == Type::Runs) return runs.front().start;
+            size_t i = 0;
+            while (bits[i] == 0) ++i;
+            return static_cast<std::uint16_t>(i * 64 + static_cast<size_t>(std::countr_zero(bits[i])));
+        }
+
+        std::uint16_t max_low() const {
+            if (type == Type::Array) return array.back();
+            if (type == Type::Runs) return runs.back().last;
+            size_t i = BITMAP_WORDS - 1;
+            while (bits[i] == 0) --i;
+            return static_cast<std::uint16_t>(i * 64 + 63 - static_cast<size_t>(std::countl_zero(bits[i])));
+        }
+
+        void to_bits(std::vector<std::uint64_t>& out) const {
+            if (type == Type::Bitmap) {
+                out = bits;
+                return;
+            }
+            out.assign(BITMAP_WORDS, 0);
+            if (type == Type::Array) {
+                for (std::uint16_t v : array) out[v >> 6] |= 1ull << (v & 63);
+            } else {
+                for (const Run& r : runs) set_range(out, r.start, r.last);
+            }
+        }
+
+        size_t count_runs() const {
+            if (type == Type::Runs) return runs.size();
+            size_t count = 0;
+            if (type == Type::Array) {
+                for (size_t i = 0; i < array.size(); ++i) {
+                    count += i == 0 || array[i] != array[i - 1] + 1;
+                }
+                return count;
+            }
+            std::uint64_t carry = 0;
+            for (std::uint64_t w : bits) {
+                count += static_cast<size_t>(std::popcount(w & ~((w << 1) | carry)));
+                carry = w >> 63;
+            }
+            return count;
+        }
+
+        void release_all() {
+            std::vector<std::uint16_t>().swap(array);
+            std::vector<std::uint64_t>().swap(bits);
+            std::vector<Run>().swap(runs);
+        }
+
+        void make_array() {
+            if (type == Type::Array) return;
+            std::vector<std::uint16_t> values;
+            values.reserve(cardinality);
+            for_each([&](std::uint16_t v) { values.push_back(v); });
+            release_all();
+            array = std::move(values);
+            type = Type::Array;
+        }
+
+        void make_bitmap() {
+            if (type == Type::Bitmap) return;
+            std::vector<std::uint64_t> words;
+            to_bits(words);
+            release_all();
+            bits = std::move(words);
+            type = Type::Bitmap;
+        }
+
+        void make_runs() {
+            if (type == Type::Runs) return;
+            std::vector<Run> ranges;
+            ranges.reserve(count_runs());
+            for_each([&](std::uint16_t v) {
+                if (!ranges.empty() && ranges.back().last + 1 == v) {
+                    ranges.back().last = v;
+                } else {
+                    ranges.push_back(Run{v, v});
+                }
+            });
+            release_all();
+            runs = std::move(ranges);
+            type = Type::Runs;
+        }
+
+        // Switches to the smallest encoding for the current contents.
+        void normalize() {
+            size_t run_bytes = count_runs() * sizeof(Run);
+            size_t array_bytes = cardinality * sizeof(std::uint16_t);
+            size_t bitmap_bytes = BITMAP_WORDS * sizeof(std::uint64_t);
+            if (run_bytes < std::min(array_bytes, bitmap_bytes)) {
+                make_runs();
+            } else if (cardinality <= ARRAY_MAX) {
+                make_array();
+            } else {
+                make_bitmap();
+            }
+        }
+
+        // Run lists are only produced by normalize(); single-value updates
+        // go through the array or bitmap form.
+        void make_mutable() {
+            if (type != Type::Runs) return;
+            if (cardinality < ARRAY_MAX) {
+                make_array();
+            } else {
+                make_bitmap();
+            }
+        }
+
+        bool add(std::uint16_t low) {
+            make_mutable();
+            if (type == Type::Array) {
+                auto it = std::lower_bound(array.begin(), array.end(), low);
+                if (it != array.end() && *it == low) return false;
+                if (cardinality < ARRAY_MAX) {
+                    array.insert(it, low);
+                    ++cardinality;
+                    return true;
+                }
+                make_bitmap();
+            }
+            std::uint64_t bit = 1ull << (low & 63);
+            if (bits[low >> 6] & bit) return false;
+            bits[low >> 6] |= bit;
+            ++cardinality;
+            return true;
+        }
+
+        bool remove(std::uint16_t low) {
+            make_mutable();
+            if (type == Type::Array) {
+                auto it = std::lower_bound(array.begin(), array.end(), low);
+                if (it == array.end() || *it != low) return false;
+                array.erase(it);
+                --cardinality;
+                return true;
             }
+            std::uint64_t bit = 1ull << (low & 63);
+            if (!(bits[low >> 6] & bit)) return false;
+            bits[low >> 6] &= ~bit;
+            --cardinality;
+            // Converting back only at half the limit keeps a container
+            // hovering around ARRAY_MAX from flipping on every update.
+            if (cardinality <= ARRAY_MAX / 2) make_array();
+            return true;
         }
+
+        size_t memory_bytes() const {
+            return array.capacity() * sizeof(std::uint16_t) + bits.capacity() * sizeof(std::uint64_t) +
+                   runs.capacity() * sizeof(Run);
+        }
+
+        void refresh_cardinality() {
+            if (type == Type::Bitmap) {
+                cardinality = popcount_words(bits);
+            } else if (type == Type::Array) {
+                cardinality = static_cast<std::uint32_t>(array.size());
+            }
+        }
+
+        // Applies op with other's bitmap form to this container's bitmap.
+        void combine_bitmap(const Container& other, WordOp op) {
+            make_bitmap();
+            if (other.type == Type::Bitmap) {
+                combine_words(bits.data(), bits.data(), other.bits.data(), op);
+            } else {
+                std::vector<std::uint64_t> words;
+                other.to_bits(words);
+                combine_words(bits.data(), bits.data(), words.data(), op);
+            }
+            cardinality = popcount_words(bits);
+        }
+
+        void unite_with(const Container& other) {
+            if (type == Type::Array && other.type == Type::Array &&
+                array.size() + other.array.size() <= ARRAY_MAX) {
+                size_t old_size = array.size();
+                array.insert(array.end(), other.array.begin(), other.array.end());
+                std::inplace_merge(array.begin(), array.begin() + static_cast<std::ptrdiff_t>(old_size), array.end());
+                array.erase(std::unique(array.begin(), array.end()), array.end());
+                refresh_cardinality();
+            } else if (other.type == Type::Array) {
+                make_mutable();
+                for (std::uint16_t v : other.array) add(v);
+            } else {
+                combine_bitmap(other, WordOp::Or);
+            }
+            normalize();
+        }
+
+        void intersect_with(const Container& other) {
+            if (type == Type::Array) {
+                std::erase_if(array, [&](std::uint16_t v) { return !other.contains(v); });
+                refresh_cardinality();
+            } else if (other.type == Type::Array) {
+                std::vector<std::uint16_t> kept;
+                for (std::uint16_t v : other.array) {
+                    if (contains(v)) kept.push_back(v);
+                }
+                release_all();
+                array = std::move(kept);
+                type = Type::Array;
+                refresh_cardinality();
+            } else {
+                combine_bitmap(other, WordOp::And);
+            }
+            if (cardinality > 0) normalize();
+        }
+
+        void subtract(const Container& other) {
+            if (type == Type::Array) {
+                std::erase_if(array, [&](std::uint16_t v) { return other.contains(v); });
+                refresh_cardinality();
+            } else if (other.type == Type::Array) {
+                make_mutable();
+                for (std::uint16_t v : other.array) remove(v);
+            } else {
+                combine_bitmap(other, WordOp::AndNot);
+            }
+            if (cardinality > 0) normalize();
+        }
+    };
+
+    std::vector<std::uint16_t> keys;
+    std::vector<Container> containers;
+    size_t count = 0;
+
+    // Flipping the sign bit makes unsigned order match int order.
+    static std::uint32_t to_key(int value) { return static_cast<std::uint32_t>(value) ^ 0x80000000u; }
+    static int from_key(std::uint32_t key) { return static_cast<int>(key ^ 0x80000000u); }
+
+    size_t find_container(std::uint16_t high) const {
+        auto it = std::lower_bound(keys.begin(), keys.end(), high);
+        return it != keys.end() && *it == high ? static_cast<size_t>(it - keys.begin()) : SIZE_MAX;
+    }
+
+    void append(std::uint16_t high, Container container) {
+        count += container.cardinality;
+        keys.push_back(high);
+        containers.push_back(std::move(container));
+    }
+
+    template <typename F>
+    void for_each(F&& f) const {
+        for (size_t i = 0; i < containers.size(); ++i) {
+            std::uint32_t base = static_cast<std::uint32_t>(keys[i]) << 16;
+            containers[i].for_each([&](std::uint16_t low) { f(from_key(base | low)); });
+        }
+    }
+
+    void recount() {
+        count = 0;
+        for (const Container& c : containers) count += c.cardinality;
+    }
+
+    // Rebuilds from the elements passing keep; used when the other operand
+    // has no container structure to walk.
+    template <typename Pred>
+    void retain_if(Pred keep) {
+        std::vector<int> kept;
+        for_each([&](int v) {
+            if (keep(v)) kept.push_back(v);
+        });
+        *this = std::move(*from_sorted(kept));
+    }
+
+public:
+    BitmapSetImpl() : SetImpl(SetKind::Bitmap) {}
+
+    static std::unique_ptr<BitmapSetImpl> from_sorted(const std::vector<int>& values) {
+        auto result = std::make_unique<BitmapSetImpl>();
+        for (size_t i = 0; i < values.size();) {
+            auto high = static_cast<std::uint16_t>(to_key(values[i]) >> 16);
+            Container container;
+            for (; i < values.size() && (to_key(values[i]) >> 16) == high; ++i) {
+                container.array.push_back(static_cast<std::uint16_t>(to_key(values[i])));
+            }
+            container.cardinality = static_cast<std::uint32_t>(container.array.size());
+            container.normalize();
+            result->append(high, std::move(container));
+        }
+        return result;
+    }
+
+    void add_bulk(const int* values, size_t n) override {
+        std::vector<int> sorted(values, values + n);
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+        if (count == 0) {
+            *this = std::move(*from_sorted(sorted));
+        } else {
+            unite(*from_sorted(sorted));
+        }
+    }
+
+    void add(int value) override {
+        std::uint32_t key = to_key(value);
+        auto high = static_cast<std::uint16_t>(key >> 16);
+        auto it = std::lower_bound(keys.begin(), keys.end(), high);
+        auto index = static_cast<size_t>(it - keys.begin());
+        if (it == keys.end() || *it != high) {
+            keys.insert(it, high);
+            containers.insert(containers.begin() + static_cast<std::ptrdiff_t>(index), Container{});
+        }
+        if (containers[index].add(static_cast<std::uint16_t>(key))) ++count;
+    }
+
+    void remove(int value) override {
+        std::uint32_t key = to_key(value);
+        size_t index = find_container(static_cast<std::uint16_t>(key >> 16));
+        if (index == SIZE_MAX || !containers[index].remove(static_cast<std::uint16_t>(key))) return;
+        --count;
+        if (containers[index].cardinality == 0) {
+            keys.erase(keys.begin() + static_cast<std::ptrdiff_t>(index));
+            containers.erase(containers.begin() + static_cast<std::ptrdiff_t>(index));
+        }
+    }
+
+    bool contains(int value) const override {
+        std::uint32_t key = to_key(value);
+        size_t index = find_container(static_cast<std::uint16_t>(key >> 16));
+        return index != SIZE_MAX && containers[index].contains(static_cast<std::uint16_t>(key));
+    }
+
+    size_t size() const override { return count; }
+
+    size_t memory_bytes() const override {
+        size_t total = sizeof(*this) + keys.capacity() * sizeof(std::uint16_t) +
+                       containers.capacity() * sizeof(Container);
+        for (const Container& c : containers) total += c.memory_bytes();
+        return total;
+    }
+
+    std::pair<int, int> bounds() const override {
+        std::uint32_t low = static_cast<std::uint32_t>(keys.front()) << 16;
+        std::uint32_t high = static_cast<std::uint32_t>(keys.back()) << 16;
+        return {from_key(low | containers.front().min_low()), from_key(high | containers.back().max_low())};
+    }
+
+    std::unique_ptr<SetImpl> clone() const override {
+        return std::make_unique<BitmapSetImpl>(*this);
+    }
+
+    std::vector<int> get_elements() const override {
+        std::vector<int> result;
+        result.reserve(count);
+        for_each([&](int v) { result.push_back(v); });
         return result;
     }
+
+    void for_each_chunk(ChunkVisitor visit) const override {
+        ChunkWriter out(visit);
+        for_each([&](int v) { out.push(v); });
+    }
+
+    void print() const override {
+        std::cout << "BitmapSet{ ";
+        for_each([](int v) { std::cout << v << " "; });
+        std::cout << "}\n";
+    }
+
+    void unite(const SetImpl& other) override {
+        if (other.kind() != SetKind::Bitmap) {
+            other.for_each([&](int v) { add(v); });
+            return;
+        }
+        const auto& rhs = static_cast<const BitmapSetImpl&>(other);
+        std::vector<std::uint16_t> merged_keys;
+        std::vector<Container> merged;
+        merged_keys.reserve(keys.size() + rhs.keys.size());
+        merged.reserve(keys.size() + rhs.keys.size());
+        size_t i = 0, j = 0;
+        while (i < keys.size() || j < rhs.keys.size()) {
+            if (j == rhs.keys.size() || (i < keys.size() && keys[i] < rhs.keys[j])) {
+                merged_keys.push_back(keys[i]);
+                merged.push_back(std::move(containers[i++]));
+            } else if (i == keys.size() || rhs.keys[j] < keys[i]) {
+                merged_keys.push_back(rhs.keys[j]);
+                merged.push_back(rhs.containers[j++]);
+            } else {
+                containers[i].unite_with(rhs.containers[j++]);
+                merged_keys.push_back(keys[i]);
+                merged.push_back(std::move(containers[i++]));
+            }
+        }
+        keys = std::move(merged_keys);
+        containers = std::move(merged);
+        recount();
+    }
+
+    void intersect(const SetImpl& other) override {
+        if (other.kind() != SetKind::Bitmap) {
+            retain_if([&](int v) { return other.contains(v); });
+            return;
+        }
+        const auto& rhs = static_cast<const BitmapSetImpl&>(other);
+        size_t out = 0;
+        for (size_t i = 0, j = 0; i < keys.size() && j < rhs.keys.size();) {
+            if (keys[i] < rhs.keys[j]) {
+                ++i;
+            } else if (rhs.keys[j] < keys[i]) {
+                ++j;
+            } else {
+                containers[i].intersect_with(rhs.containers[j++]);
+                if (containers[i].cardinality > 0) {
+                    if (out != i) {
+                        keys[out] = keys[i];
+                        containers[out] = std::move(containers[i]);
+                    }
+                    ++out;
+                }
+                ++i;
+            }
+        }
+        keys.resize(out);
+        containers.resize(out);
+        recount();
+    }
+
+    void subtract(const SetImpl& other) override {
+        if (other.kind() != SetKind::Bitmap) {
+            if (other.size() < count) {
+                other.for_each([&](int v) { remove(v); });
+            } else {
+                retain_if([&](int v) { return !other.contains(v); });
+            }
+            return;
+        }
+        const auto& rhs = static_cast<const BitmapSetImpl&>(other);
+        size_t out = 0;
+        for (size_t i = 0, j = 0; i < keys.size(); ++i) {
+            while (j < rhs.keys.size() && rhs.keys[j] < keys[i]) ++j;
+            if (j < rhs.keys.size() && rhs.keys[j] == keys[i]) containers[i].subtract(rhs.containers[j]);
+            if (containers[i].cardinality > 0) {
+                if (out != i) {
+                    keys[out] = keys[i];
+                    containers[out] = std::move(containers[i]);
+                }
+                ++out;
+            }
+        }
+        keys.resize(out);
+        containers.resize(out);
+        recount();
+    }
+};
+
+std::unique_ptr<SetImpl> make_set_impl(SetKind kind) {
+    switch (kind) {
+        case SetKind::Vector: return std::make_unique<VectorSetImpl>();
+        case SetKind::Hash: return std::make_unique<HashSetImpl>();
+        case SetKind::FlatHash: return std::make_unique<FlatHashSetImpl>();
+        case SetKind::Bitmap: return std::make_unique<BitmapSetImpl>();
+    }
+    throw std::invalid_argument("unknown SetKind");
+}
+
+const char* set_kind_name(SetKind kind) {
+    switch (kind) {
+        case SetKind::Vector: return "vector";
+        case SetKind::Hash: return "hash";
+        case SetKind::FlatHash: return "flat-hash";
+        case SetKind::Bitmap: return "bitmap";
+    }
+    return "?";
+}
+
+// When Set changes representation. It moves to `large` once it holds
+// `grow` elements and back to the sorted vector once it shrinks to
+// `shrink`; keeping shrink well below grow stops a set that hovers around
+// one size from converting on every add/remove. A large set with at least
+// `bitmap_min` elements covering at least `bitmap_density` of its value
+// range moves to the compressed bitmap, and goes back to `large` if its
+// density falls below half of that.
+struct SetTuning {
+    size_t grow = 16;
+    size_t shrink = 8;
+    SetKind large = SetKind::FlatHash;
+    size_t bitmap_min = 4096;
+    double bitmap_density = 1.0 / 16;
 };
 
+volatile size_t benchmark_sink;
+
+// Average nanoseconds per contains() on an impl of the given kind holding
+// `elements` values, half of the probes hitting.
+double measure_lookup_ns(SetKind kind, size_t elements, size_t probes) {
+    std::mt19937 rng(static_cast<unsigned>(elements));
+    std::uniform_int_distribution<int> dist(0, 1 << 20);
+    auto impl = make_set_impl(kind);
+    std::vector<int> values;
+    while (impl->size() < elements) {
+        int v = dist(rng);
+        if (!impl->contains(v)) {
+            impl->add(v);
+            values.push_back(v);
+        }
+    }
+    std::vector<int> keys(1024);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = (i % 2 == 0 && !values.empty()) ? values[i % values.size()] : dist(rng);
+    }
+
+    size_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < probes; ++i) {
+        hits += impl->contains(keys[i & 1023]);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    benchmark_sink = hits;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(probes);
+}
+
+// Splits [0, count) into up to `threads` contiguous slices and runs
+// body(begin, end, slice) for each, on its own thread when there is more
+// than one. The first exception thrown by a slice is rethrown after all
+// of them finish.
+template <typename Body>
+void for_each_slice(size_t count, unsigned threads, Body body) {
+    threads = std::max(1u, threads);
+    if (threads == 1) {
+        body(size_t{0}, count, 0u);
+        return;
+    }
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        size_t begin = count * t / threads;
+        size_t end = count * (t + 1) / threads;
+        workers.emplace_back([&, begin, end, t] {
+            try {
+                body(begin, end, t);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    for (auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
 class Set {
+    SetTuning tuning;
     std::unique_ptr<SetImpl> impl;
-    static constexpr size_t SWITCH_THRESHOLD = 20;
+    // Range seen by add(); removals leave it wider than the contents,
+    // which only understates density.
+    int low_bound = INT_MAX;
+    int high_bound = INT_MIN;
 
-    void switch_to_hash() {
-        auto elements = impl->get_elements();
-        impl = std::make_unique<HashSetImpl>();
-        for (int v : elements) impl->add(v);
+    static void validate(const SetTuning& t) {
+        if (t.large == SetKind::Vector) {
+            throw std::invalid_argument("SetTuning: large representation must be a hash");
+        }
+        if (t.shrink > t.grow) {
+            throw std::invalid_argument("SetTuning: shrink threshold above grow threshold");
+        }
+        if (!(t.bitmap_density > 0)) {
+            throw std::invalid_argument("SetTuning: bitmap density must be positive");
+        }
     }
 
-    void switch_to_vector() {
+    // Smallest slice worth a thread of its own in the bulk operations.
+    static constexpr size_t MIN_SLICE = 1 << 16;
+
+    static unsigned usable_threads(size_t count, unsigned threads) {
+        return static_cast<unsigned>(std::clamp<size_t>(count / MIN_SLICE, 1, std::max(1u, threads)));
+    }
+
+    bool dense_enough(double density, size_t count) const {
+        if (count < tuning.bitmap_min) return false;
+        double range = static_cast<double>(high_bound) - static_cast<double>(low_bound) + 1;
+        return static_cast<double>(count) >= density * range;
+    }
+
+    static SetTuning& default_tuning_storage() {
+        static SetTuning tuning;
+        return tuning;
+    }
+
+    Set(const SetTuning& t, std::unique_ptr<SetImpl> contents) : tuning(t), impl(std::move(contents)) {
+        rebalance();
+    }
+
+    void switch_to(SetKind kind) {
+        if (kind != SetKind::Vector && kind != SetKind::Bitmap) {
+            auto next = make_set_impl(kind);
+            next->reserve(impl->size());
+            next->unite(*impl);
+            impl = std::move(next);
+            return;
+        }
         auto elements = impl->get_elements();
-        impl = std::make_unique<VectorSetImpl>();
-        for (int v : elements) impl->add(v);
+        if (impl->kind() != SetKind::Vector && impl->kind() != SetKind::Bitmap) {
+            std::sort(elements.begin(), elements.end());
+        }
+        if (kind == SetKind::Vector) {
+            impl = VectorSetImpl::from_sorted(std::move(elements));
+        } else {
+            impl = BitmapSetImpl::from_sorted(elements);
+        }
+    }
+
+    // Picks the representation for the current size; used after bulk
+    // operations whose result can land on either side of the thresholds.
+    void rebalance() {
+        if (impl->size() == 0) {
+            low_bound = INT_MAX;
+            high_bound = INT_MIN;
+        } else {
+            std::tie(low_bound, high_bound) = impl->bounds();
+        }
+        if (impl->kind() == SetKind::Vector) {
+            if (impl->size() <= tuning.grow) return;
+            switch_to(tuning.large);
+        } else if (impl->size() <= tuning.shrink) {
+            switch_to(SetKind::Vector);
+            return;
+        }
+        if (impl->kind() != SetKind::Bitmap) {
+            if (dense_enough(tuning.bitmap_density, impl->size())) switch_to(SetKind::Bitmap);
+        } else if (tuning.large != SetKind::Bitmap && !dense_enough(tuning.bitmap_density / 2, impl->size())) {
+            switch_to(tuning.large);
+        }
     }
 
 public:
-    Set() : impl(std::make_unique<VectorSetImpl>()) {}
+    Set() : Set(default_tuning()) {}
+
+    explicit Set(const SetTuning& t) : tuning(t), impl(std::make_unique<VectorSetImpl>()) {
+        validate(tuning);
+    }
+
+    static const SetTuning& default_tuning() { return default_tuning_storage(); }
+
+    static void set_default_tuning(const SetTuning& t) {
+        validate(t);
+        default_tuning_storage() = t;
+    }
+
+    // Measures lookups on the sorted vector against `large` and returns a
+    // tuning that switches at the first size where `large` wins, shrinking
+    // back at half that size. Pass the result to set_default_tuning().
+    static SetTuning calibrate(SetKind large = SetKind::FlatHash) {
+        constexpr size_t sizes[] = {8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256};
+        constexpr size_t probes = 200000;
+        SetTuning result;
+        result.large = large;
+        result.grow = sizes[std::size(sizes) - 1];
+        for (size_t n : sizes) {
+            double small = std::min(measure_lookup_ns(SetKind::Vector, n, probes),
+                                    measure_lookup_ns(SetKind::Vector, n, probes));
+            double big = std::min(measure_lookup_ns(large, n, probes), measure_lookup_ns(large, n, probes));
+            if (big < small) {
+                result.grow = n;
+                break;
+            }
+        }
+        result.shrink = result.grow / 2;
+        return result;
+    }
+
+    SetKind kind() const { return impl->kind(); }
 
     void add(int value) {
-        if (impl->size() >= SWITCH_THRESHOLD &&
-            dynamic_cast<VectorSetImpl*>(impl.get())) {
-            switch_to_hash();
+        if (impl->kind() == SetKind::Vector && impl->size() >= tuning.grow) {
+            switch_to(tuning.large);
         }
 
         impl->add(value);
+        low_bound = std::min(low_bound, value);
+        high_bound = std::max(high_bound, value);
+
+        if (impl->kind() != SetKind::Vector && impl->kind() != SetKind::Bitmap &&
+            dense_enough(tuning.bitmap_density, impl->size())) {
+            switch_to(SetKind::Bitmap);
+        }
     }
 
     void remove(int value) {
         impl->remove(value);
 
-        if (impl->size() <= SWITCH_THRESHOLD &&
-            dynamic_cast<HashSetImpl*>(impl.get())) {
-            switch_to_vector();
+        if (impl->kind() != SetKind::Vector && impl->size() <= tuning.shrink) {
+            switch_to(SetKind::Vector);
+        }
+    }
+
+    // Adds every value, choosing the representation for the final size
+    // first so storage is sized once. With threads > 1 and a large input,
+    // slices are built into per-thread partial sets that are merged at the
+    // end.
+    void add_bulk(std::span<const int> values, unsigned threads = 1) {
+        if (values.empty()) return;
+        auto [lo, hi] = std::minmax_element(values.begin(), values.end());
+        low_bound = std::min(low_bound, *lo);
+        high_bound = std::max(high_bound, *hi);
+
+        // Counts duplicates, so it can only pick a larger representation
+        // than needed; rebalance() below corrects that.
+        size_t expected = impl->size() + values.size();
+        if (impl->kind() == SetKind::Vector && expected > tuning.grow) switch_to(tuning.large);
+        if (impl->kind() != SetKind::Vector && impl->kind() != SetKind::Bitmap &&
+            dense_enough(tuning.bitmap_density, expected)) {
+            switch_to(SetKind::Bitmap);
         }
+
+        unsigned slices = usable_threads(values.size(), threads);
+        if (slices == 1) {
+            impl->add_bulk(values.data(), values.size());
+        } else {
+            std::vector<std::unique_ptr<SetImpl>> partials(slices);
+            SetKind kind = impl->kind();
+            for_each_slice(values.size(), slices, [&](size_t begin, size_t end, unsigned slice) {
+                auto partial = make_set_impl(kind);
+                partial->add_bulk(values.data() + begin, end - begin);
+                partials[slice] = std::move(partial);
+            });
+            impl->reserve(impl->size() + values.size());
+            for (const auto& partial : partials) impl->unite(*partial);
+        }
+        rebalance();
+    }
+
+    static Set from_range(std::span<const int> values, unsigned threads = 1) {
+        return from_range(values, default_tuning(), threads);
+    }
+
+    static Set from_range(std::span<const int> values, const SetTuning& t, unsigned threads = 1) {
+        Set result(t);
+        result.add_bulk(values, threads);
+        return result;
     }
 
     bool contains(int value) const { return impl->contains(value); }
+
+    // out[i] = contains(values[i]); out must be at least as long as values.
+    void contains_batch(std::span<const int> values, std::span<bool> out, unsigned threads = 1) const {
+        if (out.size() < values.size()) {
+            throw std::invalid_argument("Set::contains_batch: output shorter than input");
+        }
+        for_each_slice(values.size(), usable_threads(values.size(), threads),
+                       [&](size_t begin, size_t end, unsigned) {
+                           impl->contains_batch(values.data() + begin, end - begin, out.data() + begin);
+                       });
+    }
+
     size_t size() const { return impl->size(); }
     void print() const { impl->print(); }
 
+    // Elements in unspecified order (ascending for the vector and bitmap
+    // representations).
+    template <typename F>
+    void for_each(F&& f) const { impl->for_each(std::forward<F>(f)); }
+
+    Set& operator|=(const Set& other) {
+        if (&other == this) return *this;
+        // A small vector receiving a large operand would be re-sorted and
+        // then converted anyway; convert first and merge into the hash.
+        if (impl->kind() == SetKind::Vector && impl->size() + other.size() > tuning.grow) {
+            switch_to(other.impl->kind() == SetKind::Vector ? tuning.large : other.impl->kind());
+        }
+        impl->unite(*other.impl);
+        rebalance();
+        return *this;
+    }
+
+    Set& operator&=(const Set& other) {
+        if (&other == this) return *this;
+        impl->intersect(*other.impl);
+        rebalance();
+        return *this;
+    }
+
+    Set& operator-=(const Set& other) {
+        if (&other == this) {
+            impl = std::make_unique<VectorSetImpl>();
+        } else {
+            impl->subtract(*other.impl);
+        }
+        rebalance();
+        return *this;
+    }
+
     Set union_with(const Set& other) const {
-        Set result;
-        result.impl = impl->union_with(*other.impl);
-        return result;
+        return Set(tuning, impl->union_with(*other.impl));
     }
 
     Set intersection_with(const Set& other) const {
-        Set result;
-        result.impl = impl->intersection_with(*other.impl);
-        return result;
+        return Set(tuning, impl->intersection_with(*other.impl));
+    }
+
+    Set difference_with(const Set& other) const {
+        return Set(tuning, impl->difference_with(*other.impl));
     }
 };
-int main() {
-    Set s1;
+
+// Lookup cost per impl across set sizes, the calibrated crossover, and a
+// workload that hovers at the switch point with and without hysteresis.
+void run_crossover_benchmark() {
+    constexpr size_t sizes[] = {4, 8, 16, 24, 32, 48, 64, 96, 128, 256, 1024};
+    constexpr SetKind kinds[] = {SetKind::Vector, SetKind::Hash, SetKind::FlatHash};
+    constexpr size_t probes = 500000;
+
+    std::cout << "ns/lookup      size";
+    for (SetKind kind : kinds) std::cout << "  " << set_kind_name(kind);
+    std::cout << "\n";
+    for (size_t n : sizes) {
+        std::cout << "               " << n;
+        for (SetKind kind : kinds) std::cout << "  " << measure_lookup_ns(kind, n, probes);
+        std::cout << "\n";
+    }
+
+    for (SetKind large : {SetKind::Hash, SetKind::FlatHash}) {
+        SetTuning t = Set::calibrate(large);
+        std::cout << "crossover vector -> " << set_kind_name(large) << ": grow at " << t.grow
+                  << ", shrink at " << t.shrink << "\n";
+    }
+
+    auto hover = [](const SetTuning& t) {
+        Set s(t);
+        for (int i = 0; i < static_cast<int>(t.grow); ++i) s.add(i);
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < 100000; ++round) {
+            s.add(1000);
+            s.remove(1000);
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::cout << "hover at threshold, grow 20 / shrink 20: " << hover(SetTuning{20, 20, SetKind::FlatHash})
+              << " ms\n"
+              << "hover at threshold, grow 20 / shrink 10: " << hover(SetTuning{20, 10, SetKind::FlatHash})
+              << " ms\n";
+}
+
+// Memory and set algebra on two overlapping sets of ids drawn from dense
+// ranges, per large representation, plus which one Set picks on its own.
+void run_dense_benchmark(size_t elements) {
+    std::mt19937 rng(5);
+    auto dense_ids = [&](int first) {
+        std::vector<int> ids;
+        std::bernoulli_distribution keep(0.9);
+        for (int v = first; ids.size() < elements; ++v) {
+            if (keep(rng)) ids.push_back(v);
+        }
+        return ids;
+    };
+    std::vector<int> a = dense_ids(0);
+    std::vector<int> b = dense_ids(static_cast<int>(elements / 2));
+
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    for (SetKind kind : {SetKind::Hash, SetKind::FlatHash, SetKind::Bitmap}) {
+        std::unique_ptr<SetImpl> x, y;
+        if (kind == SetKind::Bitmap) {
+            x = BitmapSetImpl::from_sorted(a);
+            y = BitmapSetImpl::from_sorted(b);
+        } else {
+            x = make_set_impl(kind);
+            y = make_set_impl(kind);
+            for (int v : a) x->add(v);
+            for (int v : b) y->add(v);
+        }
+        auto start = Clock::now();
+        auto united = x->union_with(*y);
+        auto mid = Clock::now();
+        auto common = x->intersection_with(*y);
+        auto end = Clock::now();
+        std::cout << set_kind_name(kind) << ": "
+                  << static_cast<double>(x->memory_bytes()) / static_cast<double>(x->size()) << " bytes/element, "
+                  << "union " << ms(mid - start) << " ms (" << united->size() << "), "
+                  << "intersection " << ms(end - mid) << " ms (" << common->size() << ")\n";
+    }
+
+    Set s;
+    for (int v : a) s.add(v);
+    std::cout << "Set picked " << set_kind_name(s.kind()) << " for " << s.size() << " ids\n";
+}
+
+// A filter pipeline, acc = acc & s1 & s2 & ..., per representation: the
+// allocating intersection_with() against in-place intersect().
+void run_algebra_benchmark(size_t elements) {
+    constexpr int stages = 8;
+    std::mt19937 rng(9);
+    auto range = static_cast<int>(elements * 2);
+    std::uniform_int_distribution<int> dist(0, range);
+    std::vector<std::vector<int>> inputs(stages + 1);
+    for (auto& input : inputs) {
+        for (size_t i = 0; i < elements; ++i) input.push_back(dist(rng));
+        std::sort(input.begin(), input.end());
+        input.erase(std::unique(input.begin(), input.end()), input.end());
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    for (SetKind kind : {SetKind::Vector, SetKind::Hash, SetKind::FlatHash, SetKind::Bitmap}) {
+        std::vector<std::unique_ptr<SetImpl>> sets;
+        for (const auto& input : inputs) {
+            if (kind == SetKind::Vector) {
+                sets.push_back(VectorSetImpl::from_sorted(input));
+            } else if (kind == SetKind::Bitmap) {
+                sets.push_back(BitmapSetImpl::from_sorted(input));
+            } else {
+                sets.push_back(make_set_impl(kind));
+                sets.back()->unite(*VectorSetImpl::from_sorted(input));
+            }
+        }
+
+        auto start = Clock::now();
+        std::unique_ptr<SetImpl> copied = sets[0]->clone();
+        for (int i = 1; i <= stages; ++i) copied = copied->intersection_with(*sets[i]);
+        auto mid = Clock::now();
+        std::unique_ptr<SetImpl> in_place = sets[0]->clone();
+        for (int i = 1; i <= stages; ++i) in_place->intersect(*sets[i]);
+        auto end = Clock::now();
+
+        std::cout << set_kind_name(kind) << ": intersection_with " << ms(mid - start) << " ms, in place "
+                  << ms(end - mid) << " ms (" << in_place->size() << " left)\n";
+    }
+}
+
+// Filling a set one add() at a time against add_bulk(), and contains()
+// against contains_batch(), on uniformly random ids.
+void run_bulk_benchmark(size_t elements, unsigned threads) {
+    std::mt19937 rng(13);
+    std::uniform_int_distribution<int> dist(0, INT_MAX);
+    std::vector<int> values(elements);
+    for (int& v : values) v = dist(rng);
+    std::vector<int> probes(elements);
+    for (size_t i = 0; i < elements; ++i) probes[i] = i % 2 == 0 ? values[i] : dist(rng);
+
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    auto start = Clock::now();
+    Set one_by_one;
+    for (int v : values) one_by_one.add(v);
+    auto added = Clock::now();
+    Set bulk = Set::from_range(values);
+    auto bulk_done = Clock::now();
+    Set parallel = Set::from_range(values, threads);
+    auto parallel_done = Clock::now();
+
+    size_t hits = 0;
+    for (int v : probes) hits += bulk.contains(v);
+    auto probed = Clock::now();
+    auto found = std::make_unique<bool[]>(elements);
+    bulk.contains_batch(probes, std::span<bool>(found.get(), elements));
+    auto batched = Clock::now();
+    bulk.contains_batch(probes, std::span<bool>(found.get(), elements), threads);
+    auto batched_parallel = Clock::now();
+    size_t batch_hits = static_cast<size_t>(std::count(found.get(), found.get() + elements, true));
+
+    std::cout << elements << " ids into " << set_kind_name(bulk.kind()) << " (" << bulk.size() << " distinct)\n"
+              << "  add():                      " << ms(added - start) << " ms\n"
+              << "  from_range():               " << ms(bulk_done - added) << " ms\n"
+              << "  from_range(), " << threads << " threads:    " << ms(parallel_done - bulk_done) << " ms\n"
+              << "  contains():                 " << ms(probed - parallel_done) << " ms\n"
+              << "  contains_batch():           " << ms(batched - probed) << " ms\n"
+              << "  contains_batch(), " << threads << " threads: " << ms(batched_parallel - batched) << " ms\n"
+              << "  hits " << hits << " / " << batch_hits << ", sizes " << one_by_one.size() << " / "
+              << parallel.size() << std::endl;
+}
+
+// Regression check for FlatHashSetImpl::retain_if. Builds a 16-slot table
+// whose probe chains wrap around and overlap:
+//   15:H(h15) 0:G(h15) 1:F(h15) 2:K(h2) 3:X(h3) 4:A(h1) 5:B(h2)
+// then intersects with and subtracts every subset of it, checking that each
+// survivor is still reachable. Returns false on the first failure.
+bool check_flat_hash_retain() {
+    // Home slot at capacity 16, mirroring FlatHashSetImpl::home().
+    auto home16 = [](int value) {
+        return static_cast<size_t>((static_cast<std::uint64_t>(static_cast<std::uint32_t>(value)) * 0x9E3779B97F4A7C15ull) >> 60);
+    };
+    auto with_home = [&](size_t slot, int skip) {
+        int v = skip + 1;
+        while (home16(v) != slot) ++v;
+        return v;
+    };
+    int h = with_home(15, 0), g = with_home(15, h), f = with_home(15, g);
+    int k = with_home(2, 0), x = with_home(3, 0), a = with_home(1, 0), b = with_home(2, k);
+    const std::vector<int> layout{h, g, f, k, x, a, b};
+
+    for (unsigned subset = 0; subset < (1u << layout.size()); ++subset) {
+        FlatHashSetImpl filter;
+        for (size_t i = 0; i < layout.size(); ++i) {
+            if (subset & (1u << i)) filter.add(layout[i]);
+        }
+        for (bool intersect : {true, false}) {
+            FlatHashSetImpl table;
+            for (int v : layout) table.add(v);
+            if (intersect) {
+                table.intersect(filter);
+            } else {
+                table.subtract(filter);
+            }
+            size_t expected = 0;
+            for (int v : layout) {
+                bool survives = filter.contains(v) == intersect;
+                expected += survives;
+                if (table.contains(v) != survives) {
+                    std::cout << (intersect ? "intersect" : "subtract") << " with subset " << subset
+                              << ": wrong membership for " << v << "\n";
+                    return false;
+                }
+            }
+            if (table.size() != expected) {
+                std::cout << (intersect ? "intersect" : "subtract") << " with subset " << subset << ": size "
+                          << table.size() << ", expected " << expected << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The benchmark suite includes this file and defines SET_NO_MAIN.
+#ifndef SET_NO_MAIN
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::strcmp(argv[1], "--check") == 0) {
+        bool ok = check_flat_hash_retain();
+        std::cout << "flat hash retain_if: " << (ok ? "ok" : "FAILED") << "\n";
+        return ok ? 0 : 1;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-crossover") == 0) {
+        run_crossover_benchmark();
+        return 0;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-algebra") == 0) {
+        run_algebra_benchmark(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200000);
+        return 0;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-bulk") == 0) {
+        run_bulk_benchmark(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5000000,
+                           argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10))
+                                    : std::max(1u, std::thread::hardware_concurrency()));
+        return 0;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-dense") == 0) {
+        run_dense_benchmark(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000);
+        return 0;
+    }
+
+    Set s1(SetTuning{20, 10, SetKind::FlatHash});
     std::cout << "Adding elements to s1:\n";
     for (int i = 0; i < 25; ++i) {
         s1.add(i);
@@ -204,3 +1796,4 @@ int main() {
 
     return 0;
 }
+#endif
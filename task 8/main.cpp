@@ -3,14 +3,195 @@
 #include <map>
 #include <memory>
 #include <unordered_map>
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <unordered_set>
+#include <random>
+#include <bit>
+#include <thread>
+#include <exception>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+enum class OpCode : std::uint8_t { Const, Load, Add, Mul };
+
+// One step of a compiled expression. Instruction i writes register i from
+// `a`, which is the constant (Const), the variable slot (Load) or the left
+// operand register, and `b`, the right operand register.
+struct Instruction {
+    OpCode op;
+    std::int32_t a;
+    std::int32_t b;
+};
+
+class Expression;
+class Simplifier;
+
+// Collects instructions while an expression emits itself. A node reached
+// through several parents is emitted once, and variable names are turned
+// into dense slot indices.
+class ProgramBuilder {
+    std::vector<Instruction> code;
+    std::vector<std::string> slotNames;
+    std::unordered_map<std::string, std::int32_t> slotIndex;
+    std::unordered_map<int, std::int32_t> constantRegisters;
+    std::unordered_map<const Expression*, std::int32_t> emitted;
+    bool fixedLayout = false;
+
+    std::int32_t push(Instruction instruction) {
+        code.push_back(instruction);
+        return static_cast<std::int32_t>(code.size() - 1);
+    }
+
+public:
+    ProgramBuilder() = default;
+
+    // Slots follow `layout`; compiling a variable missing from it throws.
+    explicit ProgramBuilder(const std::vector<std::string>& layout) : slotNames(layout), fixedLayout(true) {
+        for (size_t i = 0; i < layout.size(); ++i) {
+            if (!slotIndex.emplace(layout[i], static_cast<std::int32_t>(i)).second) {
+                throw std::invalid_argument("duplicate variable in slot layout: " + layout[i]);
+            }
+        }
+    }
+
+    std::int32_t build(const Expression& expr);
+
+    std::int32_t constant(int value) {
+        auto it = constantRegisters.find(value);
+        if (it != constantRegisters.end()) return it->second;
+        return constantRegisters[value] = push({OpCode::Const, value, 0});
+    }
+
+    std::int32_t load(const std::string& name) {
+        auto it = slotIndex.find(name);
+        if (it == slotIndex.end()) {
+            if (fixedLayout) throw std::invalid_argument("variable not in slot layout: " + name);
+            it = slotIndex.emplace(name, static_cast<std::int32_t>(slotNames.size())).first;
+            slotNames.push_back(name);
+        }
+        return push({OpCode::Load, it->second, 0});
+    }
+
+    std::int32_t binary(OpCode op, std::int32_t left, std::int32_t right) {
+        return push({op, left, right});
+    }
+
+    std::vector<Instruction>& instructions() { return code; }
+    std::vector<std::string>& slots() { return slotNames; }
+};
+
+// Results of the operation nodes a formula reaches through more than one
+// parent, for one context. The constructor walks the formula once and gives
+// each shared node a slot; every other node is evaluated in place, so a
+// tree-shaped formula pays no memo lookups at all. Build one memo per
+// formula and clear() it (which keeps its storage) before the next context.
+class EvaluationMemo {
+    std::unordered_map<const Expression*, size_t> slots;
+    std::vector<int> values;
+    std::vector<std::uint8_t> computed;
+    size_t computedCount = 0;
+
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    explicit EvaluationMemo(const Expression& formula);
+
+    bool hasSharedNodes() const { return !slots.empty(); }
+
+    // Slot of a shared node, or npos for a node with a single parent.
+    size_t slot(const Expression* node) const {
+        auto it = slots.find(node);
+        return it == slots.end() ? npos : it->second;
+    }
+
+    const int* find(size_t slot) const { return computed[slot] ? &values[slot] : nullptr; }
+
+    void store(size_t slot, int value) {
+        values[slot] = value;
+        computed[slot] = 1;
+        ++computedCount;
+    }
+
+    void clear() {
+        std::fill(computed.begin(), computed.end(), std::uint8_t{0});
+        computedCount = 0;
+    }
+
+    size_t sharedCount() const { return slots.size(); }
+    size_t size() const { return computedCount; }
+};
 
 class Expression {
 public:
     virtual ~Expression() = default;
     virtual int evaluate(const std::map<std::string, int>& context) const = 0;
+    // Like evaluate(), but each shared operation node is computed at most
+    // once per memo, so a formula whose subtrees are shared costs time linear
+    // in its unique nodes rather than in its fully expanded tree. Use it for a
+    // DAG evaluated against a few contexts; without shared nodes it is
+    // evaluate(). For many contexts, compile() once instead: the program is
+    // deduplicated the same way and runs without virtual calls or lookups.
+    virtual int evaluateCached(const std::map<std::string, int>& context, EvaluationMemo&) const {
+        return evaluate(context);
+    }
     virtual void print(std::ostream& os) const = 0;
+    // Appends this node's instructions; returns the register with its value.
+    // Children are emitted through builder.build().
+    virtual std::int32_t emit(ProgramBuilder& builder) const = 0;
+
+    virtual std::optional<int> constantValue() const { return std::nullopt; }
+    virtual void visitChildren(const std::function<void(const Expression&)>&) const {}
+    // For a node applying `op`, appends its operands and returns true.
+    virtual bool appendOperands(OpCode, std::vector<std::shared_ptr<Expression>>&) const { return false; }
+    // Simplified equivalent of this node; `self` is the pointer owning it.
+    virtual std::shared_ptr<Expression> simplify(Simplifier&, const std::shared_ptr<Expression>& self) const {
+        return self;
+    }
 };
 
+inline EvaluationMemo::EvaluationMemo(const Expression& formula) {
+    // Count each node's parents, descending into a node only on its first
+    // visit; leaves are never memoized, as reading one is as cheap as a slot.
+    std::unordered_map<const Expression*, size_t> parents;
+    std::vector<const Expression*> operations;
+    std::function<void(const Expression&)> count = [&](const Expression& node) {
+        if (parents[&node]++ > 0) return;
+        bool operation = false;
+        node.visitChildren([&](const Expression& child) {
+            operation = true;
+            count(child);
+        });
+        if (operation) operations.push_back(&node);
+    };
+    count(formula);
+    for (const Expression* node : operations) {
+        if (parents[node] > 1) slots.emplace(node, slots.size());
+    }
+    values.resize(slots.size());
+    computed.resize(slots.size());
+}
+
+inline std::int32_t ProgramBuilder::build(const Expression& expr) {
+    auto it = emitted.find(&expr);
+    if (it != emitted.end()) return it->second;
+    std::int32_t result = expr.emit(*this);
+    emitted.emplace(&expr, result);
+    return result;
+}
+
 class Constant : public Expression {
     int value;
     explicit Constant(int val) : value(val) {}
@@ -25,6 +206,12 @@ public:
     void print(std::ostream& os) const override {
         os << value;
     }
+
+    std::int32_t emit(ProgramBuilder& builder) const override {
+        return builder.constant(value);
+    }
+
+    std::optional<int> constantValue() const override { return value; }
 };
 
 class Variable : public Expression {
@@ -41,6 +228,10 @@ public:
     void print(std::ostream& os) const override {
         os << name;
     }
+
+    std::int32_t emit(ProgramBuilder& builder) const override {
+        return builder.load(name);
+    }
 };
 
 
@@ -60,6 +251,17 @@ public:
         return Op::apply(left->evaluate(context), right->evaluate(context));
     }
 
+    int evaluateCached(const std::map<std::string, int>& context, EvaluationMemo& memo) const override {
+        if (!memo.hasSharedNodes()) return evaluate(context);
+        size_t slot = memo.slot(this);
+        if (slot != EvaluationMemo::npos) {
+            if (const int* cached = memo.find(slot)) return *cached;
+        }
+        int value = Op::apply(left->evaluateCached(context, memo), right->evaluateCached(context, memo));
+        if (slot != EvaluationMemo::npos) memo.store(slot, value);
+        return value;
+    }
+
     void print(std::ostream& os) const override {
         os << "(";
         left->print(os);
@@ -67,21 +269,396 @@ public:
         right->print(os);
         os << ")";
     }
+
+    std::int32_t emit(ProgramBuilder& builder) const override {
+        std::int32_t l = builder.build(*left);
+        std::int32_t r = builder.build(*right);
+        return builder.binary(Op::opcode, l, r);
+    }
+
+    void visitChildren(const std::function<void(const Expression&)>& visit) const override {
+        visit(*left);
+        visit(*right);
+    }
+
+    bool appendOperands(OpCode op, std::vector<std::shared_ptr<Expression>>& out) const override {
+        if (op != Op::opcode) return false;
+        out.push_back(left);
+        out.push_back(right);
+        return true;
+    }
+
+    std::shared_ptr<Expression> simplify(Simplifier& simplifier,
+                                         const std::shared_ptr<Expression>& self) const override;
+};
+
+// Op applied across any number of operands, left to right. Produced by
+// Simplifier when it merges a chain of the same operator.
+template <typename Op>
+class NaryOperation : public Expression {
+    std::vector<std::shared_ptr<Expression>> operands;
+
+public:
+    explicit NaryOperation(std::vector<std::shared_ptr<Expression>> ops) : operands(std::move(ops)) {
+        if (operands.size() < 2) throw std::invalid_argument("NaryOperation needs at least two operands");
+    }
+
+    int evaluate(const std::map<std::string, int>& context) const override {
+        int result = operands[0]->evaluate(context);
+        for (size_t i = 1; i < operands.size(); ++i) result = Op::apply(result, operands[i]->evaluate(context));
+        return result;
+    }
+
+    int evaluateCached(const std::map<std::string, int>& context, EvaluationMemo& memo) const override {
+        if (!memo.hasSharedNodes()) return evaluate(context);
+        size_t slot = memo.slot(this);
+        if (slot != EvaluationMemo::npos) {
+            if (const int* cached = memo.find(slot)) return *cached;
+        }
+        int result = operands[0]->evaluateCached(context, memo);
+        for (size_t i = 1; i < operands.size(); ++i) {
+            result = Op::apply(result, operands[i]->evaluateCached(context, memo));
+        }
+        if (slot != EvaluationMemo::npos) memo.store(slot, result);
+        return result;
+    }
+
+    void print(std::ostream& os) const override {
+        os << "(";
+        for (size_t i = 0; i < operands.size(); ++i) {
+            if (i > 0) os << " " << Op::symbol << " ";
+            operands[i]->print(os);
+        }
+        os << ")";
+    }
+
+    std::int32_t emit(ProgramBuilder& builder) const override {
+        std::int32_t result = builder.build(*operands[0]);
+        for (size_t i = 1; i < operands.size(); ++i) {
+            std::int32_t next = builder.build(*operands[i]);
+            result = builder.binary(Op::opcode, result, next);
+        }
+        return result;
+    }
+
+    void visitChildren(const std::function<void(const Expression&)>& visit) const override {
+        for (const auto& operand : operands) visit(*operand);
+    }
+
+    bool appendOperands(OpCode op, std::vector<std::shared_ptr<Expression>>& out) const override {
+        if (op != Op::opcode) return false;
+        out.insert(out.end(), operands.begin(), operands.end());
+        return true;
+    }
+
+    std::shared_ptr<Expression> simplify(Simplifier& simplifier,
+                                         const std::shared_ptr<Expression>& self) const override;
 };
 
 struct Add {
-    static int apply(int a, int b) { return a + b; }
+    static constexpr OpCode opcode = OpCode::Add;
+    static constexpr char symbol = '+';
+    static constexpr int identity = 0;
+    static bool absorbs(int) { return false; }
+    // Wraps on overflow, like applyBlock, instead of being undefined.
+    static int apply(int a, int b) {
+        return static_cast<int>(static_cast<std::uint32_t>(a) + static_cast<std::uint32_t>(b));
+    }
+
+    // out[i] = a[i] + b[i] with two's-complement wrap-around; lanes that
+    // overflowed get overflow[i] = 1 (flags are only ever set, never cleared).
+    static void applyBlock(const int* a, const int* b, int* out, std::uint8_t* overflow, size_t n) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 4 <= n; i += 4) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            __m128i sum = _mm_add_epi32(x, y);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), sum);
+            // Overflow iff both operands differ in sign from the sum.
+            __m128i wrapped = _mm_and_si128(_mm_xor_si128(x, sum), _mm_xor_si128(y, sum));
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(wrapped));
+            for (; mask; mask &= mask - 1) overflow[i + std::countr_zero(static_cast<unsigned>(mask))] = 1;
+        }
+#endif
+        for (; i < n; ++i) {
+            std::uint32_t sum = static_cast<std::uint32_t>(a[i]) + static_cast<std::uint32_t>(b[i]);
+            out[i] = static_cast<int>(sum);
+            overflow[i] |= ((static_cast<std::uint32_t>(a[i]) ^ sum) & (static_cast<std::uint32_t>(b[i]) ^ sum)) >> 31;
+        }
+    }
 };
 struct Multiply {
-    static int apply(int a, int b) { return a * b; }
+    static constexpr OpCode opcode = OpCode::Mul;
+    static constexpr char symbol = '*';
+    static constexpr int identity = 1;
+    static bool absorbs(int value) { return value == 0; }
+    static int apply(int a, int b) {
+        return static_cast<int>(static_cast<std::uint32_t>(a) * static_cast<std::uint32_t>(b));
+    }
+
+    // Same contract as Add::applyBlock. SSE2 has no 32-bit multiply, so the
+    // vector path needs SSE4.1; otherwise the 64-bit product is checked per lane.
+    static void applyBlock(const int* a, const int* b, int* out, std::uint8_t* overflow, size_t n) {
+        size_t i = 0;
+#if defined(__SSE4_1__)
+        for (; i + 4 <= n; i += 4) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            __m128i low = _mm_mullo_epi32(x, y);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), low);
+            // High words of the full products: lanes 0/2 from the even
+            // products, lanes 1/3 from the odd ones.
+            __m128i even = _mm_mul_epi32(x, y);
+            __m128i odd = _mm_mul_epi32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32));
+            __m128i high = _mm_blend_epi16(_mm_srli_epi64(even, 32), odd, 0xCC);
+            // The product fits iff the high word is the sign extension of the low one.
+            __m128i fits = _mm_cmpeq_epi32(high, _mm_srai_epi32(low, 31));
+            int mask = ~_mm_movemask_ps(_mm_castsi128_ps(fits)) & 0xF;
+            for (; mask; mask &= mask - 1) overflow[i + std::countr_zero(static_cast<unsigned>(mask))] = 1;
+        }
+#endif
+        for (; i < n; ++i) {
+            std::int64_t product = static_cast<std::int64_t>(a[i]) * b[i];
+            out[i] = static_cast<int>(static_cast<std::uint32_t>(product));
+            overflow[i] |= product != static_cast<std::int32_t>(product);
+        }
+    }
 };
 
 using Addition = BinaryOperation<Add>;
 using Multiplication = BinaryOperation<Multiply>;
 
+// Columnar input for batch evaluation: one contiguous array per variable,
+// all of the same length. The columns are borrowed, not copied.
+class ColumnContext {
+    std::unordered_map<std::string, std::span<const int>> columns;
+    size_t rowCount = 0;
+
+public:
+    void add(const std::string& name, std::span<const int> column) {
+        if (!columns.empty() && column.size() != rowCount) {
+            throw std::invalid_argument("ColumnContext: column '" + name + "' has a different length");
+        }
+        rowCount = column.size();
+        columns[name] = column;
+    }
+
+    // Throws std::out_of_range for an unknown variable, like Variable::evaluate.
+    std::span<const int> at(const std::string& name) const { return columns.at(name); }
+    size_t rows() const { return rowCount; }
+};
+
+// An expression flattened into straight-line register code. Variables are
+// read from an int array indexed by slot, so evaluation involves no virtual
+// calls, no string comparisons and no allocation for programs of up to
+// INLINE_REGISTERS instructions.
+class CompiledExpression {
+    static constexpr size_t INLINE_REGISTERS = 64;
+    // Rows per batch block; a block of every register stays cache-resident
+    // for programs of a few dozen instructions.
+    static constexpr size_t BATCH_BLOCK = 128;
+
+    std::vector<Instruction> code;
+    std::vector<std::string> slotNames;
+    std::int32_t result;
+
+    int run(const int* values, int* registers) const {
+        for (size_t i = 0; i < code.size(); ++i) {
+            const Instruction& in = code[i];
+            switch (in.op) {
+                case OpCode::Const: registers[i] = in.a; break;
+                case OpCode::Load: registers[i] = values[in.a]; break;
+                case OpCode::Add: registers[i] = Add::apply(registers[in.a], registers[in.b]); break;
+                case OpCode::Mul: registers[i] = Multiply::apply(registers[in.a], registers[in.b]); break;
+            }
+        }
+        return registers[result];
+    }
+
+    // Runs the program once over rows [begin, begin + n) of the columns.
+    // Loads alias the input columns; constant registers are filled once by
+    // the caller, so only Add/Mul write to the scratch block.
+    void runBlock(const int* const* columns, size_t begin, size_t n, int* scratch, const int** registers,
+                  int* out, std::uint8_t* overflow) const {
+        for (size_t i = 0; i < code.size(); ++i) {
+            const Instruction& in = code[i];
+            int* block = scratch + i * BATCH_BLOCK;
+            switch (in.op) {
+                case OpCode::Const: registers[i] = block; break;
+                case OpCode::Load: registers[i] = columns[in.a] + begin; break;
+                case OpCode::Add:
+                    Add::applyBlock(registers[in.a], registers[in.b], block, overflow, n);
+                    registers[i] = block;
+                    break;
+                case OpCode::Mul:
+                    Multiply::applyBlock(registers[in.a], registers[in.b], block, overflow, n);
+                    registers[i] = block;
+                    break;
+            }
+        }
+        std::copy_n(registers[result], n, out + begin);
+    }
+
+public:
+    explicit CompiledExpression(const Expression& expr, ProgramBuilder builder = {}) {
+        result = builder.build(expr);
+        code = std::move(builder.instructions());
+        slotNames = std::move(builder.slots());
+    }
+
+    // Variable name of each slot, in slot order.
+    const std::vector<std::string>& slots() const { return slotNames; }
+    size_t size() const { return code.size(); }
+
+    // Slot of a variable, or -1 if the expression does not use it.
+    int slotOf(const std::string& name) const {
+        for (size_t i = 0; i < slotNames.size(); ++i) {
+            if (slotNames[i] == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // Slot array for a map context; throws std::out_of_range for a missing
+    // variable, like Variable::evaluate.
+    std::vector<int> bind(const std::map<std::string, int>& context) const {
+        std::vector<int> values;
+        values.reserve(slotNames.size());
+        for (const auto& name : slotNames) values.push_back(context.at(name));
+        return values;
+    }
+
+    int evaluate(std::span<const int> values) const {
+        if (values.size() < slotNames.size()) {
+            throw std::invalid_argument("CompiledExpression: fewer values than slots");
+        }
+        if (code.size() <= INLINE_REGISTERS) {
+            int registers[INLINE_REGISTERS];
+            return run(values.data(), registers);
+        }
+        std::vector<int> registers(code.size());
+        return run(values.data(), registers.data());
+    }
+
+    int evaluate(const std::map<std::string, int>& context) const {
+        return evaluate(bind(context));
+    }
+
+    // Evaluates every row of the columns (one per slot, each at least `rows`
+    // long) into out[0, rows). Arithmetic wraps instead of being undefined;
+    // a row whose computation overflowed anywhere gets overflow[row] = 1 when
+    // an overflow span is given. Blocks are split across `threads` workers.
+    // Returns the number of rows that overflowed.
+    size_t evaluateBatch(std::span<const int* const> columns, size_t rows, std::span<int> out,
+                         std::span<std::uint8_t> overflow = {}, unsigned threads = 1) const {
+        if (columns.size() < slotNames.size()) {
+            throw std::invalid_argument("CompiledExpression: fewer columns than slots");
+        }
+        if (out.size() < rows || (!overflow.empty() && overflow.size() < rows)) {
+            throw std::invalid_argument("CompiledExpression: output shorter than the batch");
+        }
+        size_t blocks = (rows + BATCH_BLOCK - 1) / BATCH_BLOCK;
+        threads = static_cast<unsigned>(std::clamp<size_t>(threads, 1, std::max<size_t>(blocks, 1)));
+        std::vector<size_t> overflowed(threads);
+        std::vector<std::exception_ptr> errors(threads);
+
+        auto worker = [&](unsigned t) {
+            try {
+                std::vector<int> scratch(code.size() * BATCH_BLOCK);
+                std::vector<const int*> registers(code.size());
+                for (size_t i = 0; i < code.size(); ++i) {
+                    if (code[i].op == OpCode::Const) {
+                        std::fill_n(scratch.begin() + i * BATCH_BLOCK, BATCH_BLOCK, code[i].a);
+                    }
+                }
+                std::uint8_t flags[BATCH_BLOCK];
+                for (size_t block = blocks * t / threads; block < blocks * (t + 1) / threads; ++block) {
+                    size_t begin = block * BATCH_BLOCK;
+                    size_t n = std::min(BATCH_BLOCK, rows - begin);
+                    std::fill_n(flags, n, std::uint8_t{0});
+                    runBlock(columns.data(), begin, n, scratch.data(), registers.data(), out.data(), flags);
+                    if (!overflow.empty()) std::copy_n(flags, n, overflow.data() + begin);
+                    overflowed[t] += static_cast<size_t>(std::count(flags, flags + n, std::uint8_t{1}));
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        };
+        if (threads == 1) {
+            worker(0);
+        } else {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (unsigned t = 0; t < threads; ++t) workers.emplace_back(worker, t);
+            for (auto& w : workers) w.join();
+        }
+        for (auto& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+        size_t total = 0;
+        for (size_t count : overflowed) total += count;
+        return total;
+    }
+
+    // Same over a ColumnContext; throws std::out_of_range for a missing column.
+    size_t evaluateBatch(const ColumnContext& context, std::span<int> out, std::span<std::uint8_t> overflow = {},
+                         unsigned threads = 1) const {
+        std::vector<const int*> columns;
+        columns.reserve(slotNames.size());
+        for (const auto& name : slotNames) columns.push_back(context.at(name).data());
+        return evaluateBatch(columns, context.rows(), out, overflow, threads);
+    }
+
+    void print(std::ostream& os) const {
+        for (size_t i = 0; i < code.size(); ++i) {
+            const Instruction& in = code[i];
+            os << "r" << i << " = ";
+            switch (in.op) {
+                case OpCode::Const: os << in.a; break;
+                case OpCode::Load: os << slotNames[in.a] << " [slot " << in.a << "]"; break;
+                case OpCode::Add: os << "r" << in.a << " + r" << in.b; break;
+                case OpCode::Mul: os << "r" << in.a << " * r" << in.b; break;
+            }
+            os << "\n";
+        }
+    }
+};
+
+inline CompiledExpression compile(const Expression& expr) {
+    return CompiledExpression(expr);
+}
+
+// Compiles against a fixed slot layout so several formulas can share one
+// value array.
+inline CompiledExpression compile(const Expression& expr, const std::vector<std::string>& layout) {
+    return CompiledExpression(expr, ProgramBuilder(layout));
+}
+
 class ExpressionFactory {
+    // Operation nodes are keyed by operator and child identity. Children are
+    // interned too, so equal structure means equal keys. Entries hold weak
+    // references: an entry whose node is still alive keeps its children
+    // alive, so a live entry's key can never name a recycled address.
+    struct BinaryKey {
+        OpCode op;
+        const Expression* left;
+        const Expression* right;
+
+        bool operator==(const BinaryKey&) const = default;
+    };
+
+    struct BinaryKeyHash {
+        size_t operator()(const BinaryKey& key) const {
+            size_t h = std::hash<const void*>()(key.left);
+            h ^= std::hash<const void*>()(key.right) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+            return h ^ static_cast<size_t>(key.op);
+        }
+    };
+
     std::unordered_map<int, std::shared_ptr<Constant>> constants;
     std::unordered_map<std::string, std::shared_ptr<Variable>> variables;
+    std::unordered_map<BinaryKey, std::weak_ptr<Expression>, BinaryKeyHash> binaries;
+    size_t purgeThreshold = 1024;
 
     ExpressionFactory() {
         for(int i = -5; i <= 256; ++i) {
@@ -127,27 +704,322 @@ public:
     void removeVariable(const std::string& name) {
         variables.erase(name);
     }
+
+    // Returns the existing node for (Op, left, right) if one is alive.
+    template <typename Op>
+    std::shared_ptr<BinaryOperation<Op>> createBinary(std::shared_ptr<Expression> left,
+                                                      std::shared_ptr<Expression> right) {
+        auto& entry = binaries[BinaryKey{Op::opcode, left.get(), right.get()}];
+        if (auto existing = entry.lock()) {
+            return std::static_pointer_cast<BinaryOperation<Op>>(existing);
+        }
+        auto node = std::make_shared<BinaryOperation<Op>>(std::move(left), std::move(right), Op::symbol);
+        entry = node;
+        if (binaries.size() >= purgeThreshold) {
+            purgeExpired();
+            purgeThreshold = std::max<size_t>(1024, binaries.size() * 2);
+        }
+        return node;
+    }
+
+    // Drops entries whose nodes have been destroyed.
+    void purgeExpired() {
+        std::erase_if(binaries, [](const auto& entry) { return entry.second.expired(); });
+    }
+
+    size_t binaryCount() const {
+        return static_cast<size_t>(std::count_if(binaries.begin(), binaries.end(),
+                                                 [](const auto& entry) { return !entry.second.expired(); }));
+    }
 };
 
 template <typename T1, typename T2>
 std::shared_ptr<Addition> add(T1&& l, T2&& r) {
-    return std::make_shared<Addition>(
+    return ExpressionFactory::instance().createBinary<Add>(
             std::forward<T1>(l),
-            std::forward<T2>(r),
-            '+'
+            std::forward<T2>(r)
     );
 }
 
 template <typename T1, typename T2>
 std::shared_ptr<Multiplication> mul(T1&& l, T2&& r) {
-    return std::make_shared<Multiplication>(
+    return ExpressionFactory::instance().createBinary<Multiply>(
             std::forward<T1>(l),
-            std::forward<T2>(r),
-            '*'
+            std::forward<T2>(r)
     );
 }
 
-int main() {
+// Horner-style formula over x0..x7, shared by the evaluation benchmarks.
+std::shared_ptr<Expression> benchmarkFormula(std::vector<std::string>& names) {
+    auto& factory = ExpressionFactory::instance();
+    std::shared_ptr<Expression> formula = factory.createConstant(1);
+    for (int i = 0; i < 8; ++i) {
+        std::string name = "x";
+        name += std::to_string(i);
+        names.push_back(std::move(name));
+        auto term = mul(factory.createVariable(names.back()), factory.createConstant(i + 2));
+        formula = add(mul(formula, factory.createConstant(3)), term);
+    }
+    return formula;
+}
+
+// Evaluates one formula over many contexts, through the tree with a map
+// and through the compiled program with a slot array.
+void runCompileBenchmark(int iterations) {
+    std::vector<std::string> names;
+    std::shared_ptr<Expression> formula = benchmarkFormula(names);
+    CompiledExpression compiled = compile(*formula, names);
+
+    std::map<std::string, int> context;
+    std::vector<int> values(names.size());
+    using Clock = std::chrono::steady_clock;
+    long long treeSum = 0;
+    auto start = Clock::now();
+    for (int it = 0; it < iterations; ++it) {
+        for (size_t i = 0; i < names.size(); ++i) context[names[i]] = (it + static_cast<int>(i)) & 1023;
+        treeSum += formula->evaluate(context);
+    }
+    auto middle = Clock::now();
+    long long compiledSum = 0;
+    for (int it = 0; it < iterations; ++it) {
+        for (size_t i = 0; i < names.size(); ++i) values[i] = (it + static_cast<int>(i)) & 1023;
+        compiledSum += compiled.evaluate(values);
+    }
+    auto end = Clock::now();
+
+    auto ns = [&](Clock::duration d) { return std::chrono::duration<double, std::nano>(d).count() / iterations; };
+    std::cout << compiled.size() << " instructions, " << compiled.slots().size() << " slots\n"
+              << "tree:     " << ns(middle - start) << " ns/eval\n"
+              << "compiled: " << ns(end - middle) << " ns/eval\n"
+              << (treeSum == compiledSum ? "results match" : "RESULTS DIFFER") << "\n";
+}
+
+// Number of distinct nodes reachable from expr.
+inline size_t countNodes(const Expression& expr) {
+    std::unordered_set<const Expression*> seen;
+    std::vector<const Expression*> pending{&expr};
+    while (!pending.empty()) {
+        const Expression* node = pending.back();
+        pending.pop_back();
+        if (!seen.insert(node).second) continue;
+        node->visitChildren([&](const Expression& child) { pending.push_back(&child); });
+    }
+    return seen.size();
+}
+
+// Rewrites an expression bottom-up: merges chains of one operator into a
+// single n-ary node, folds the constants of each chain into one through
+// ExpressionFactory::createConstant, and applies x + 0 = x, x * 1 = x and
+// x * 0 = 0. The last rule drops the other operands, so variables that only
+// appeared there no longer need a value in the context. Nodes with several
+// parents are simplified once and stay shared; chains are only merged
+// through operands that nothing else references, so sharing is never
+// expanded into copies.
+class Simplifier {
+    std::unordered_map<const Expression*, std::shared_ptr<Expression>> done;
+
+public:
+    struct Result {
+        std::shared_ptr<Expression> expression;
+        size_t nodesBefore;
+        size_t nodesAfter;
+
+        size_t removed() const { return nodesBefore > nodesAfter ? nodesBefore - nodesAfter : 0; }
+    };
+
+    // Repeats the pass while it keeps shrinking the expression: a node
+    // shared only through the memo is not merged into its parent in the
+    // pass that produced it.
+    Result run(const std::shared_ptr<Expression>& expr) {
+        Result result{expr, countNodes(*expr), 0};
+        result.nodesAfter = result.nodesBefore;
+        for (int pass = 0; pass < 8; ++pass) {
+            done.clear();
+            auto simplified = visit(result.expression);
+            size_t nodes = countNodes(*simplified);
+            if (simplified == result.expression) break;
+            result.expression = std::move(simplified);
+            bool shrank = nodes < result.nodesAfter;
+            result.nodesAfter = nodes;
+            if (!shrank) break;
+        }
+        done.clear();
+        return result;
+    }
+
+    std::shared_ptr<Expression> visit(const std::shared_ptr<Expression>& expr) {
+        auto it = done.find(expr.get());
+        if (it != done.end()) return it->second;
+        auto simplified = expr->simplify(*this, expr);
+        done.emplace(expr.get(), simplified);
+        return simplified;
+    }
+
+    template <typename Op>
+    std::shared_ptr<Expression> simplifyChain(const Expression& node, const std::shared_ptr<Expression>& self) {
+        std::vector<std::shared_ptr<Expression>> pending;
+        node.appendOperands(Op::opcode, pending);
+        std::reverse(pending.begin(), pending.end());
+
+        std::vector<std::shared_ptr<Expression>> operands;
+        std::optional<int> folded;
+        size_t constants = 0;
+        bool changed = false;
+        while (!pending.empty()) {
+            std::shared_ptr<Expression> operand = std::move(pending.back());
+            pending.pop_back();
+            // Two owners means the parent's pointer plus this copy, so the
+            // operand is referenced from nowhere else and can be merged.
+            bool unshared = operand.use_count() <= 2;
+            std::vector<std::shared_ptr<Expression>> nested;
+            if (unshared && operand->appendOperands(Op::opcode, nested)) {
+                pending.insert(pending.end(), nested.rbegin(), nested.rend());
+                changed = true;
+                continue;
+            }
+            std::shared_ptr<Expression> simplified = visit(operand);
+            std::vector<std::shared_ptr<Expression>> parts;
+            // A chain of this operator built by simplifying an unshared
+            // operand (so held only by the memo and here) is merged too; its
+            // parts are already simplified.
+            if (unshared && simplified != operand && simplified.use_count() <= 2 &&
+                simplified->appendOperands(Op::opcode, parts)) {
+                changed = true;
+            } else {
+                changed |= simplified != operand;
+                parts.push_back(std::move(simplified));
+            }
+            for (auto& part : parts) {
+                if (auto value = part->constantValue()) {
+                    folded = folded ? Op::apply(*folded, *value) : *value;
+                    ++constants;
+                } else {
+                    operands.push_back(std::move(part));
+                }
+            }
+        }
+        if (folded && (constants > 1 || *folded == Op::identity || Op::absorbs(*folded))) changed = true;
+        if (!changed) return self;
+
+        auto& factory = ExpressionFactory::instance();
+        if (folded && Op::absorbs(*folded)) return factory.createConstant(*folded);
+        if (folded && *folded != Op::identity) operands.push_back(factory.createConstant(*folded));
+        if (operands.empty()) return factory.createConstant(Op::identity);
+        if (operands.size() == 1) return operands[0];
+        if (operands.size() == 2) return factory.createBinary<Op>(operands[0], operands[1]);
+        return std::make_shared<NaryOperation<Op>>(std::move(operands));
+    }
+};
+
+inline Simplifier::Result simplify(const std::shared_ptr<Expression>& expr) {
+    Simplifier simplifier;
+    return simplifier.run(expr);
+}
+
+template <typename Op>
+std::shared_ptr<Expression> BinaryOperation<Op>::simplify(Simplifier& simplifier,
+                                                          const std::shared_ptr<Expression>& self) const {
+    return simplifier.simplifyChain<Op>(*this, self);
+}
+
+template <typename Op>
+std::shared_ptr<Expression> NaryOperation<Op>::simplify(Simplifier& simplifier,
+                                                        const std::shared_ptr<Expression>& self) const {
+    return simplifier.simplifyChain<Op>(*this, self);
+}
+
+// A formula whose every level uses the previous one twice,
+// e(k+1) = (e(k) + x) + (e(k) + x). Hash-consing makes the two halves one
+// node, so it has about 2*depth unique nodes but 2^depth leaves when
+// expanded as a tree.
+void runDagBenchmark(int depth) {
+    auto& factory = ExpressionFactory::instance();
+    auto x = factory.createVariable("x");
+    std::shared_ptr<Expression> formula = x;
+    for (int i = 0; i < depth; ++i) {
+        formula = add(add(formula, x), add(formula, x));
+    }
+    std::map<std::string, int> context{{"x", 1}};
+
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    auto start = Clock::now();
+    int tree = formula->evaluate(context);
+    auto middle = Clock::now();
+    EvaluationMemo memo(*formula);
+    int cached = formula->evaluateCached(context, memo);
+    auto end = Clock::now();
+
+    std::cout << "depth " << depth << ": " << factory.binaryCount() << " interned operation nodes\n"
+              << "evaluate():       " << ms(middle - start) << " ms\n"
+              << "evaluateCached(): " << ms(end - middle) << " ms (" << memo.size() << " shared nodes memoized)\n"
+              << (tree == cached ? "results match" : "RESULTS DIFFER") << "\n";
+}
+
+void runBatchBenchmark(size_t rows, unsigned threads) {
+    std::vector<std::string> names;
+    std::shared_ptr<Expression> formula = benchmarkFormula(names);
+    CompiledExpression compiled = compile(*formula, names);
+
+    // Small values everywhere except a sprinkling of rows that overflow.
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> small(-1000, 1000);
+    std::vector<std::vector<int>> data(names.size(), std::vector<int>(rows));
+    ColumnContext columns;
+    for (size_t v = 0; v < names.size(); ++v) {
+        for (auto& value : data[v]) value = small(rng);
+        for (size_t r = v; r < rows; r += 997) data[v][r] = 1 << 29;
+        columns.add(names[v], data[v]);
+    }
+
+    using Clock = std::chrono::steady_clock;
+    std::vector<int> values(names.size());
+    std::vector<int> perRow(rows);
+    auto start = Clock::now();
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t v = 0; v < names.size(); ++v) values[v] = data[v][r];
+        perRow[r] = compiled.evaluate(values);
+    }
+    auto middle = Clock::now();
+    std::vector<int> single(rows);
+    std::vector<std::uint8_t> overflow(rows);
+    size_t overflowed = compiled.evaluateBatch(columns, single, overflow);
+    auto end = Clock::now();
+    std::vector<int> parallel(rows);
+    std::vector<std::uint8_t> parallelOverflow(rows);
+    size_t parallelOverflowed = compiled.evaluateBatch(columns, parallel, parallelOverflow, threads);
+    auto last = Clock::now();
+
+    // Both paths wrap identically, so every row must agree, overflowed or not.
+    bool match = single == parallel && perRow == single && overflow == parallelOverflow &&
+                 overflowed == parallelOverflowed;
+
+    auto ns = [&](Clock::duration d) { return std::chrono::duration<double, std::nano>(d).count() / rows; };
+    std::cout << rows << " rows, " << compiled.size() << " instructions, " << overflowed << " rows overflowed\n"
+              << "per-row compiled:     " << ns(middle - start) << " ns/row\n"
+              << "batch, 1 thread:      " << ns(end - middle) << " ns/row\n"
+              << "batch, " << threads << " thread(s):  " << ns(last - end) << " ns/row\n"
+              << (match ? "results match" : "RESULTS DIFFER") << "\n";
+}
+
+// The benchmark suite includes this file and defines EXPRESSION_NO_MAIN.
+#ifndef EXPRESSION_NO_MAIN
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::strcmp(argv[1], "--bench-batch") == 0) {
+        size_t rows = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+        unsigned threads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : std::thread::hardware_concurrency();
+        runBatchBenchmark(rows, std::max(1u, threads));
+        return 0;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-dag") == 0) {
+        runDagBenchmark(argc > 2 ? std::atoi(argv[2]) : 20);
+        return 0;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-compile") == 0) {
+        runCompileBenchmark(argc > 2 ? std::atoi(argv[2]) : 1000000);
+        return 0;
+    }
+
     auto& factory = ExpressionFactory::instance();
 
     auto c = factory.createConstant(2);
@@ -166,5 +1038,34 @@ int main() {
     expr2->print(std::cout);
     std::cout << "\nResult: " << expr2->evaluate(context) << "\n";
 
+    auto again = mul(add(c, x), factory.createConstant(4));
+    std::cout << "Rebuilt expression 2 is " << (again == expr2 ? "the same node" : "a new node") << "\n";
+
+    auto redundant = mul(add(add(factory.createConstant(2), factory.createConstant(3)), add(x, factory.createConstant(0))),
+                         mul(factory.createConstant(1), add(x, add(x, x))));
+    Simplifier::Result simplified = simplify(redundant);
+    std::cout << "Simplify: ";
+    redundant->print(std::cout);
+    std::cout << " -> ";
+    simplified.expression->print(std::cout);
+    std::cout << " (" << simplified.removed() << " of " << simplified.nodesBefore << " nodes removed, result "
+              << redundant->evaluate(context) << " = " << simplified.expression->evaluate(context) << ")\n";
+
+    CompiledExpression program = compile(*expr2);
+    std::cout << "Compiled:\n";
+    program.print(std::cout);
+    std::cout << "Compiled result: " << program.evaluate(context) << "\n";
+
+    std::vector<int> xs{3, -7, 2147483646};
+    ColumnContext columns;
+    columns.add("x", xs);
+    std::vector<int> results(xs.size());
+    std::vector<std::uint8_t> overflow(xs.size());
+    program.evaluateBatch(columns, results, overflow);
+    std::cout << "Batch over x = 3, -7, 2147483646:";
+    for (size_t i = 0; i < results.size(); ++i) std::cout << " " << (overflow[i] ? "overflow" : std::to_string(results[i]));
+    std::cout << "\n";
+
     factory.removeVariable("x");
-}
\ No newline at end of file
+}
+#endif